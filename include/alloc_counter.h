@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdint.h>
+
+// Heap allocation counter, used to check that the steady-state event path
+// never allocates.
+//
+// Build with -DALLOC_COUNTER=1 and link with
+//   -Wl,--wrap=malloc -Wl,--wrap=calloc -Wl,--wrap=realloc
+// so every malloc/calloc/realloc in the image (including operator new and
+// Arduino String) goes through the counting wrappers. Without the flag the
+// functions below compile to nothing and report zero.
+
+#ifndef ALLOC_COUNTER
+#define ALLOC_COUNTER 0
+#endif
+
+// Only allocations made by this task are counted in taskAllocations()
+void trackTaskAllocations(void* taskHandle);
+
+uint32_t taskAllocations();
+uint32_t totalAllocations();
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+
+// Telegram command channel: a task that long-polls getUpdates on its own
+// keep-alive connection and hands every new message to a handler.
+//
+// The server holds each poll open for up to COMMAND_POLL_TIMEOUT_S seconds
+// and answers as soon as a message arrives, so commands are seen within a
+// round trip while an idle group costs about one request per timeout. The
+// next update_id is kept in NVS, every update is handled once across reboots.
+
+#ifndef COMMAND_POLL_TIMEOUT_S
+#define COMMAND_POLL_TIMEOUT_S 50
+#endif
+
+// The read timeout is the poll timeout plus 10 s, in a uint16_t of milliseconds
+static_assert((COMMAND_POLL_TIMEOUT_S + 10) * 1000 <= UINT16_MAX,
+              "COMMAND_POLL_TIMEOUT_S is too long for the HTTP read timeout, 55 s at most");
+
+#ifndef COMMAND_CHANNEL_CORE
+#define COMMAND_CHANNEL_CORE 0
+#endif
+
+// text is the message text ("" for non-text messages), isReply tells whether
+// it was sent as a reply to another message. Runs on the command task.
+typedef void (*CommandHandler)(const char* text, bool isReply);
+
+bool startCommandChannel(const char* botToken, CommandHandler handler);
+
+struct CommandChannelStats {
+    uint32_t polls;
+    uint32_t failures;
+    uint32_t updates;
+    int32_t nextOffset;
+};
+
+CommandChannelStats getCommandChannelStats();
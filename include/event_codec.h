@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Compact binary form of the events kept in the event log.
+//
+// An event is one tag byte (kind, new state, sensor), the time since the
+// previous event as a zigzag varint of seconds, and a CRC-8 over both: 3
+// bytes for events up to a minute apart, 4 up to two hours, against 40-70
+// for the rendered line. The text is only produced when the event is sent.
+//
+// Times are kept to the second, all a rendered line shows, and are relative,
+// so a decoder needs the time the encoder started from.
+// Where the time base changes (the clock became known, or a new power-up)
+// the encoder writes a time base entry carrying the absolute time first.
+//
+// Kept free of Arduino headers so it also builds natively for the bench.
+
+// Decoded event. sequence is its position in the log, set by the log.
+struct EventRecord {
+    int64_t time_ms;        // see StoredTime in time_service.h
+    uint32_t timeSession;
+    uint32_t sequence;
+    uint8_t type;           // NOTIFY_SENSOR_CHANGE or NOTIFY_VACANCY
+    uint8_t sensor;
+    uint8_t active;
+};
+
+// Time the next entry is relative to
+struct EventTimeBase {
+    int64_t time_s;         // EventRecord::time_ms in whole seconds
+    uint32_t session;
+};
+
+// The time base an event starts, e.g. for the header of a new sector
+EventTimeBase eventTimeBase(const EventRecord& record);
+
+// Longest encodeEvent() output: a time base entry plus the event itself
+static const size_t eventEncodedMax = 14 + 12;
+
+// Appends the entries for record to out, returns how many bytes it wrote
+size_t encodeEvent(const EventRecord& record, EventTimeBase& base, uint8_t* out);
+
+enum EventDecodeResult {
+    EVENT_DECODED,      // record is filled in
+    EVENT_END,          // erased flash, nothing was ever written here
+    EVENT_DAMAGED,      // bad CRC or truncated, where the next entry starts is unknown
+};
+
+// Decodes the next event from in, skipping time base entries on the way.
+// consumed is set to the bytes used; sequence is left alone and time_ms
+// comes back rounded down to the second.
+EventDecodeResult decodeEvent(const uint8_t* in, size_t length, EventTimeBase& base,
+                              EventRecord& record, size_t* consumed);
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <esp_partition.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <Preferences.h>
+#include "event_codec.h"
+
+// Circular log of the events that could not be sent, in a raw flash
+// partition, kept until they can.
+//
+// The partition is split into 4 KB sectors used round robin, so every sector
+// sees the same number of erases. A sector starts with a header carrying a
+// sequence number that grows by one per sector written, the position of its
+// first event and the time the first event is relative to; the events
+// follow in the compact form of event_codec.h, 3-4 bytes each. Every event
+// has a position that only ever grows, counted from the first event ever
+// logged.
+//
+// Appending writes one entry, plus one erase when a new sector is started.
+// When the log is full the oldest sector is erased and its unsent events are
+// dropped. The head is found again at boot from the sector sequence numbers
+// and a scan of the newest sector, the tail (oldest unsent event) is kept in
+// NVS and only moved once Telegram has confirmed the events before it.
+//
+// Every entry carries a CRC. An entry torn by a power loss mid-write ends
+// the sector it is in: the rest of it is skipped and writing carries on in
+// the next one. Recovery reads one header per sector and the newest sector,
+// whatever the size of the backlog.
+//
+// append() only stages the event in RAM, which takes microseconds; staged
+// events go to flash in one batch from flushIfDue(). The staging area lives
+// in RTC memory and is written out by begin() after a brownout, watchdog,
+// panic or software reset, so only a power loss can take staged events with
+// it. There can be only one EventLog, it owns that area.
+
+#ifndef EVENT_LOG_PARTITION
+#define EVENT_LOG_PARTITION "evlog"
+#endif
+
+// Events staged in RTC memory at most
+#ifndef EVENT_LOG_STAGE_CAPACITY
+#define EVENT_LOG_STAGE_CAPACITY 32
+#endif
+
+// flushIfDue() writes the staged events once there are this many, or once the
+// oldest has waited EVENT_LOG_FLUSH_MS
+#ifndef EVENT_LOG_FLUSH_COUNT
+#define EVENT_LOG_FLUSH_COUNT 16
+#endif
+
+#ifndef EVENT_LOG_FLUSH_MS
+#define EVENT_LOG_FLUSH_MS 10000
+#endif
+
+struct EventLogStats {
+    uint32_t size;          // unsent events, staged ones included
+    uint32_t staged;        // not in flash yet
+    uint32_t flushes;
+    uint32_t sectors;
+    uint32_t appended;      // since boot
+    uint32_t appendedBytes;
+    uint32_t released;
+    uint32_t dropped;       // overwritten before they were sent
+    uint32_t sectorErases;
+    uint32_t corruptSectors;    // closed early at boot because of a torn entry
+    uint32_t corruptEvents;     // lost to damaged entries on the way back out
+};
+
+class EventLog {
+public:
+    // Finds the partition, recovers head and tail and writes out what was
+    // staged before a reset. False when there is no partition, the log then
+    // stays empty and append() fails.
+    bool begin(const char* partitionLabel = EVENT_LOG_PARTITION);
+
+    // Thread safe. sequence is ignored, the log assigns it on the way to
+    // flash. Only touches flash when the staging area is full.
+    bool append(const EventRecord& record);
+
+    // Writes the staged events when enough have piled up or the oldest has
+    // waited long enough. Call from loop().
+    void flushIfDue();
+    // Writes the staged events now, e.g. before reading the log back
+    void flush();
+
+    // Positions of the oldest unsent event and one past the newest in flash.
+    // Staged events get theirs when they are written.
+    uint32_t tail();
+    uint32_t head();
+
+    // Copies up to max intact events starting at position, returns how many,
+    // and moves position past everything it looked at, damaged entries
+    // included. Nothing once position has fallen behind the tail.
+    size_t read(uint32_t& position, EventRecord* records, size_t max);
+
+    // Everything before position has been delivered
+    void release(uint32_t position);
+
+    EventLogStats stats();
+
+private:
+    static const uint32_t sectorSize = 4096;
+
+    struct SectorHeader {
+        uint32_t magic;
+        uint32_t sequence;
+        uint32_t first;         // position of the first event in the sector
+        uint32_t session;       // time base of the first event
+        int64_t time_s;
+        uint32_t reserved;
+        uint32_t crc;
+    };
+    static const uint32_t headerSize = sizeof(SectorHeader);
+
+    bool readHeader(uint32_t sector, SectorHeader& header);
+    uint32_t sectorEnd(uint32_t sequence);
+    bool startSector(uint32_t sequence, const EventRecord& record);
+    bool writeRun(const uint8_t* run, size_t length, uint32_t events, const EventTimeBase& base);
+    void flushStaged();
+    void recover();
+
+    const esp_partition_t* partition_ = nullptr;
+    SemaphoreHandle_t lock_ = nullptr;
+    Preferences prefs_;
+    uint32_t sectors_ = 0;
+    uint32_t head_ = 0;
+    uint32_t tail_ = 0;
+
+    // Sector being written
+    bool started_ = false;
+    uint32_t headSequence_ = 0;
+    uint32_t writeOffset_ = 0;      // sectorSize once it must not be written any more
+    EventTimeBase writeBase_ = {};
+
+    uint32_t corruptThrough_ = 0;   // damaged events before it are counted already
+    unsigned long firstStagedAt_ = 0;
+    uint8_t sectorBuffer_[sectorSize];
+    EventLogStats stats_ = {};
+};
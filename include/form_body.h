@@ -0,0 +1,46 @@
+#pragma once
+
+#include <Arduino.h>
+#include "url_encode.h"
+
+// Body of a form POST, "<prefix><url-encoded value>", produced while
+// HTTPClient pulls it.
+//
+// The prefix (e.g. "chat_id=123&text=") goes out as is, the value is encoded
+// byte by byte on the way out, so the encoded text never exists in memory.
+// size() is exact and known before the request starts, which lets the body go
+// out with a Content-Length instead of being buffered first.
+class FormBodyStream : public Stream {
+public:
+    FormBodyStream(const char* prefix, const char* value);
+
+    size_t size() const { return size_; }
+
+    // Starts over from the first byte, for a request that has to be resent
+    void rewind();
+
+    int available() override { return (int)(size_ - sent_); }
+    int read() override;
+    int peek() override;
+    size_t readBytes(char* buffer, size_t length);
+    size_t write(uint8_t) override { return 0; }
+
+private:
+    bool fill();
+
+    const char* prefix_;
+    size_t prefixLength_;
+    size_t prefixPos_ = 0;
+
+    const char* text_;
+    size_t textLength_;
+    size_t textPos_ = 0;
+
+    // Encoding of the current byte, up to "%XX"
+    char out_[3];
+    uint8_t outLength_ = 0;
+    uint8_t outPos_ = 0;
+
+    size_t size_;
+    size_t sent_ = 0;
+};
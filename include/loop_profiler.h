@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Where loop() spends its time, to find what keeps it from looking at the
+// sensors.
+//
+// loop() marks the end of each of its stages. The time since the previous
+// mark, or since the start of the iteration, goes into that stage's
+// histogram, and the time from one iteration's start to the next into the
+// period histogram: the longest gap between two looks at the sensors.
+// Durations come from esp_timer, one microsecond read per mark. The CPU
+// cycle counter would be finer, but at 240 MHz it wraps every 18 s, and the
+// gaps this is meant to find are seconds long.
+//
+// Bucket i counts durations in [2^i, 2^(i+1)) us, bucket 0 also takes 0 us
+// and the last one everything longer, so a fixed table covers 1 us to
+// several seconds.
+//
+// Build with -DLOOP_PROFILER=1. Without it the marks compile to nothing and
+// the stats read zero.
+
+#ifndef LOOP_PROFILER
+#define LOOP_PROFILER 0
+#endif
+
+#ifndef LOOP_PROFILE_BUCKETS
+#define LOOP_PROFILE_BUCKETS 24
+#endif
+
+enum LoopStage : uint8_t {
+    LOOP_STAGE_WIFI,        // serviceWifi() and what a link change starts
+    LOOP_STAGE_CLOCK,       // replay trigger and persistTimeAnchor()
+    LOOP_STAGE_EVENT_LOG,   // eventLog.flushIfDue()
+    LOOP_STAGE_SENSORS,     // edges or polling, debouncing, queueing events
+    LOOP_STAGE_STATUS,      // status request pickup, allocation check
+    LOOP_STAGE_DELAY,       // delay(100), as long as the scheduler makes it
+    LOOP_STAGE_COUNT,
+    LOOP_PERIOD = LOOP_STAGE_COUNT,     // start of one iteration to the next
+};
+
+struct LoopStageStats {
+    uint32_t count;
+    uint32_t mean_us;
+    uint32_t p99_us;        // upper edge of the bucket the 99th percentile falls in
+    uint32_t max_us;
+    uint32_t buckets[LOOP_PROFILE_BUCKETS];
+};
+
+#if LOOP_PROFILER
+
+// First thing in loop()
+void loopProfileStart();
+
+// After each stage, in order
+void loopProfileEnd(LoopStage stage);
+
+#else
+
+inline void loopProfileStart() {}
+inline void loopProfileEnd(LoopStage stage) { (void)stage; }
+
+#endif
+
+// A stage, or LOOP_PERIOD. Safe to call from any task.
+LoopStageStats getLoopStageStats(LoopStage stage);
+
+// "wifi", "sensors", ..., "period"
+const char* loopStageName(LoopStage stage);
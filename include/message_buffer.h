@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+// Fixed-capacity text buffer for building messages without touching the heap.
+// Appends that do not fit are cut off and flagged rather than failing, so a
+// message is always a valid, terminated string.
+template <size_t N>
+class MessageBuffer {
+    static_assert(N > 1, "MessageBuffer needs room for at least one character");
+
+public:
+    MessageBuffer() { clear(); }
+
+    void clear() {
+        length_ = 0;
+        truncated_ = false;
+        text_[0] = '\0';
+    }
+
+    MessageBuffer& append(const char* text) {
+        size_t available = N - 1 - length_;
+        size_t length = strlen(text);
+        if (length > available) {
+            length = available;
+            truncated_ = true;
+        }
+        memcpy(text_ + length_, text, length);
+        length_ += length;
+        text_[length_] = '\0';
+        return *this;
+    }
+
+    MessageBuffer& append(char c) {
+        if (length_ < N - 1) {
+            text_[length_++] = c;
+            text_[length_] = '\0';
+        } else {
+            truncated_ = true;
+        }
+        return *this;
+    }
+
+    MessageBuffer& appendf(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+        va_list args;
+        va_start(args, format);
+        appendv(format, args);
+        va_end(args);
+        return *this;
+    }
+
+    MessageBuffer& appendv(const char* format, va_list args) {
+        size_t available = N - length_;
+        int written = vsnprintf(text_ + length_, available, format, args);
+        if (written < 0) {
+            text_[length_] = '\0';
+        } else if ((size_t)written >= available) {
+            length_ = N - 1;
+            truncated_ = true;
+        } else {
+            length_ += written;
+        }
+        return *this;
+    }
+
+    const char* c_str() const { return text_; }
+    size_t length() const { return length_; }
+    bool empty() const { return length_ == 0; }
+    bool truncated() const { return truncated_; }
+    static constexpr size_t capacity() { return N - 1; }
+
+private:
+    char text_[N];
+    size_t length_;
+    bool truncated_;
+};
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sensors.h"
+
+// Network delivery runs on its own FreeRTOS task, pinned to the other core
+// than loop(). The sensing side only ever enqueues fixed-size events and
+// never waits for the network.
+
+#ifndef NOTIFIER_QUEUE_LENGTH
+#define NOTIFIER_QUEUE_LENGTH 32
+#endif
+
+#ifndef NOTIFIER_CORE
+#define NOTIFIER_CORE 0     // loop() runs on core 1
+#endif
+
+// Sensor events arriving within this window of the first one are sent as a
+// single message. 0 sends every event on its own.
+#ifndef NOTIFY_COALESCE_WINDOW_MS
+#define NOTIFY_COALESCE_WINDOW_MS 1500
+#endif
+
+// Events at or above this priority flush the window immediately
+#ifndef NOTIFY_BYPASS_PRIORITY
+#define NOTIFY_BYPASS_PRIORITY SENSOR_PRIORITY_HIGH
+#endif
+
+#ifndef NOTIFY_MAX_BATCH
+#define NOTIFY_MAX_BATCH 16
+#endif
+
+// Events taken off the queue and waiting for their turn. Higher priorities
+// always go out first, so alarms never wait behind occupancy chatter.
+#ifndef NOTIFY_PENDING_CAPACITY
+#define NOTIFY_PENDING_CAPACITY 32
+#endif
+
+// Telegram accepts about 20 messages a minute into one group. Messages are
+// paced by a token bucket: NOTIFY_RATE_BURST can go out back to back, then one
+// every NOTIFY_RATE_INTERVAL_MS, which keeps any minute at 20 or fewer.
+#ifndef NOTIFY_RATE_BURST
+#define NOTIFY_RATE_BURST 3
+#endif
+
+#ifndef NOTIFY_RATE_INTERVAL_MS
+#define NOTIFY_RATE_INTERVAL_MS 3500
+#endif
+
+enum NotifyEventType : uint8_t {
+    NOTIFY_SENSOR_CHANGE,   // sensor went active / inactive
+    NOTIFY_VACANCY,         // last occupancy sensor went inactive
+    NOTIFY_STATUS,          // status report requested from the group
+    NOTIFY_WIFI_CONNECTED,  // WiFi (re)connected, flush pending messages
+    NOTIFY_REPLAY_PENDING,  // clock became known while connected, flush pending messages
+};
+
+struct NotifyEvent {
+    NotifyEventType type;
+    uint8_t sensor;         // index into sensorTable, NOTIFY_SENSOR_CHANGE only
+    bool active;
+    SensorPriority priority;
+    SensorMask state;       // all debounced sensor states when the event was raised
+    uint32_t enqueued_us;   // set by notify()
+    int64_t raised_us;      // monotonicMicros() when it happened, see time_service.h
+};
+
+struct NotifierStats {
+    uint32_t enqueued;
+    uint32_t delivered;
+    uint32_t dropped;           // queue was full
+    uint32_t depth;             // events waiting right now, queued or pending
+    uint32_t maxDepth;
+    uint32_t messages;          // deliver() calls, one per coalesced batch
+    uint32_t throttled;         // deliveries the server asked us to retry later
+    uint32_t rateLimited;       // times a due message had to wait for the rate limit
+    uint32_t lastLatency_us;    // enqueue to delivery
+    uint32_t maxLatency_us;
+    uint64_t totalLatency_us;
+};
+
+// Only plain sensor events can share a message
+inline bool isCoalescable(NotifyEventType type) {
+    return type == NOTIFY_SENSOR_CHANGE || type == NOTIFY_VACANCY;
+}
+
+// Receives one message worth of events: either a batch of coalescable events,
+// highest priority first and in arrival order within a priority, or a single
+// event of any other type. Returns 0 once the events are dealt with (sent or
+// saved for later), or the number of seconds the server wants us to wait
+// before the same events are offered again.
+typedef uint32_t (*NotifyDeliverFn)(const NotifyEvent* events, size_t count);
+typedef void (*NotifyIdleFn)();
+
+// Creates the queue and the notifier task. deliver() is called on the notifier
+// task, idle() (optional) roughly every idleIntervalMs.
+bool startNotifier(NotifyDeliverFn deliver, NotifyIdleFn idle, uint32_t idleIntervalMs);
+
+// Enqueues an event without blocking. Returns false when the queue is full.
+bool notify(NotifyEvent& event);
+
+// Enqueues a NOTIFY_REPLAY_PENDING event without blocking. It is never lost:
+// with the queue full the request is held, and the notifier task adds the
+// event once it has room. Requests held meanwhile make a single event.
+void requestReplay();
+
+NotifierStats getNotifierStats();
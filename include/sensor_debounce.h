@@ -0,0 +1,49 @@
+#pragma once
+
+#include "sensors.h"
+
+// Debounces raw sensor samples using the per-sensor timings in sensorTable.
+//
+// A raw change only becomes the stable state once it has held for the
+// sensor's settle time in that direction, and an active sensor is not
+// released before its minimum active time has passed. A change that has
+// held long enough still counts when the input flips back before the next
+// update(); the flip back is then a change of its own. Each update() only
+// looks at the sensors whose raw state differs from the stable one, and the
+// state per sensor is two timestamps.
+//
+// Timestamps are micros() values; the unsigned differences stay correct
+// across the 32-bit wrap as long as updates are less than ~71 minutes apart.
+class SensorDebouncer {
+public:
+    // Accept raw as the stable state without any settling
+    void reset(SensorMask raw, uint32_t now_us);
+
+    // Feed the raw inputs as of now_us and return the debounced state. The
+    // inputs are taken to have held since the previous call, as they have
+    // when every edge is reported. Call it for every change, and also
+    // periodically with raw() so that settle timers expire when the inputs
+    // stop changing. A sensor changes at most once per call.
+    SensorMask update(SensorMask raw, uint32_t now_us);
+
+    // Same for inputs that are only read now and then. What changed back by
+    // this read is only known to have held until the previous one, so a
+    // glitch caught by a single read does not count.
+    SensorMask sample(SensorMask raw, uint32_t now_us);
+
+    SensorMask stable() const { return stable_; }
+    SensorMask raw() const { return raw_; }
+
+private:
+    // Whether sensor i's candidate is acceptable by now_us, and since when
+    bool settled(size_t i, uint32_t now_us, uint32_t* due_us) const;
+    // Candidates that went back count if they had settled by held_us
+    SensorMask apply(SensorMask raw, uint32_t now_us, uint32_t held_us);
+
+    SensorMask stable_ = 0;
+    SensorMask raw_ = 0;
+    SensorMask pending_ = 0;                // raw differs from stable and is settling
+    uint32_t pendingSince_[sensorCount] = {};
+    uint32_t stableSince_[sensorCount] = {};
+    uint32_t lastUpdate_us_ = 0;
+};
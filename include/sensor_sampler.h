@@ -0,0 +1,12 @@
+#pragma once
+
+#include "sensors.h"
+
+// 1 = read the GPIO input register once per sample, 0 = digitalRead() every pin
+#ifndef SENSOR_SAMPLER_GPIO_REGISTER
+#define SENSOR_SAMPLER_GPIO_REGISTER 1
+#endif
+
+// Samples every sensor in sensorTable and returns their active states
+// (bit set = closed / occupied). Safe to call from an ISR.
+SensorMask sampleSensorInputs();
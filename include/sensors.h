@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// One bit per sensor, bit i = sensorTable[i] is active (closed / occupied)
+typedef uint32_t SensorMask;
+
+enum SensorPull : uint8_t {
+    SENSOR_PULL_NONE,
+    SENSOR_PULL_UP,
+};
+
+// How urgently a change has to reach the group
+enum SensorPriority : uint8_t {
+    SENSOR_PRIORITY_LOW,        // occupancy chatter
+    SENSOR_PRIORITY_NORMAL,
+    SENSOR_PRIORITY_HIGH,       // alarms, never held back by coalescing
+};
+
+struct SensorDescriptor {
+    uint8_t pin;
+    bool activeLow;             // true when LOW on the pin means closed / occupied
+    SensorPull pull;
+    bool occupancy;             // counts towards "employee present in the shop"
+    SensorPriority priority;
+    const char* label;          // name used in the status report
+    const char* activeState;    // status text while active
+    const char* inactiveState;  // status text while inactive
+    const char* onActive;       // notification template (%s = timestamp), nullptr = silent
+    const char* onInactive;
+    uint16_t settleActiveMs;    // raw input must stay active this long before it counts
+    uint16_t settleInactiveMs;  // same for going inactive
+    uint16_t minActiveMs;       // once active, stay active at least this long
+};
+
+// Table order is also the order of the status report.
+// Magnetic contacts read LOW when closed because of the pull-ups and bounce
+// for a few milliseconds, so both directions get a short settle time.
+// PIR outputs read HIGH while they see motion: a new occupant is reported
+// immediately, but the output has to stay low for a while, and the desk has
+// to have been occupied for a minimum time, before it counts as vacant.
+static constexpr SensorDescriptor sensorTable[] = {
+    { 14, true,  SENSOR_PULL_UP,   false, SENSOR_PRIORITY_HIGH,   "Shop",        "Closed",   "Open",
+      "Shutter closed at %s", "Shutter open at %s",
+      30, 30, 0 },
+    { 25, true,  SENSOR_PULL_UP,   false, SENSOR_PRIORITY_NORMAL, "Office Door", "Closed",   "Open",
+      "Office door closed at %s", "Office door open at %s",
+      20, 20, 0 },
+    { 27, true,  SENSOR_PULL_UP,   false, SENSOR_PRIORITY_HIGH,   "Drawer",      "Closed",   "Open",
+      "Drawer closed at %s", "Drawer open at %s",
+      20, 20, 0 },
+    { 13, false, SENSOR_PULL_NONE, true,  SENSOR_PRIORITY_LOW,    "Computer 1",  "Occupied", "Vacant",
+      "Employee is present at main Computer 1 at %s", nullptr,
+      0, 3000, 10000 },
+    { 12, false, SENSOR_PULL_NONE, true,  SENSOR_PRIORITY_LOW,    "Computer 2",  "Occupied", "Vacant",
+      "Employee is present at Computer 2 at %s", nullptr,
+      0, 3000, 10000 },
+};
+
+static constexpr size_t sensorCount = sizeof(sensorTable) / sizeof(sensorTable[0]);
+static_assert(sensorCount <= sizeof(SensorMask) * 8, "SensorMask is too narrow for sensorTable");
+
+// Sent when the last occupancy sensor goes inactive
+static constexpr const char* vacancyMessage = "No employee present in the shop at %s";
+
+constexpr SensorMask sensorBit(size_t index) {
+    return (SensorMask)1 << index;
+}
+
+constexpr SensorMask occupancyMaskFrom(size_t index) {
+    return index == sensorCount ? 0
+        : ((sensorTable[index].occupancy ? sensorBit(index) : 0) | occupancyMaskFrom(index + 1));
+}
+
+constexpr SensorMask activeLowMaskFrom(size_t index) {
+    return index == sensorCount ? 0
+        : ((sensorTable[index].activeLow ? sensorBit(index) : 0) | activeLowMaskFrom(index + 1));
+}
+
+static constexpr SensorMask occupancyMask = occupancyMaskFrom(0);
+static constexpr SensorMask activeLowMask = activeLowMaskFrom(0);
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <WiFiClientSecure.h>
+#include <HTTPClient.h>
+#include "form_body.h"
+
+// Longest text sendMessage accepts, in characters. Longer ones fail with a 400.
+static const size_t telegramMessageLimit = 4096;
+
+// Where the Bot API lives. Point it at a stand-in server on the bench with
+// e.g. "http://192.168.1.20:8081" (plain http:// skips TLS), see
+// src/standin/telegram_standin.cpp.
+#ifndef TELEGRAM_API_URL
+#define TELEGRAM_API_URL "https://api.telegram.org"
+#endif
+
+// One long-lived HTTPS connection to the Telegram Bot API.
+//
+// The TLS socket is kept open between requests (HTTP keep-alive), so only
+// the first request after boot or after a drop pays for the handshake. When
+// a reused socket turns out to be dead the request is retried once on a
+// fresh connection. An instance is not thread safe, give every task that
+// talks to Telegram its own one.
+class TelegramConnection {
+public:
+    // apiUrl is scheme://host[:port][/path], without the /bot<token> part
+    explicit TelegramConnection(const char* botToken, const char* apiUrl = TELEGRAM_API_URL);
+
+    // Socket read timeout, has to outlast the server side of a long poll
+    void setTimeout(uint16_t timeoutMs) { timeoutMs_ = timeoutMs; }
+
+    // All return the HTTP status code, or a negative HTTPClient error.
+    // The response must be consumed (body() / stream()) and then finish()ed.
+    // A 429 response is consumed already, retryAfter() tells how long to wait.
+    int get(const char* method, const String& query = String());
+    // Sends the body with its exact Content-Length, encoding it on the fly
+    int postForm(const char* method, FormBodyStream& body);
+
+    String body() { return http_.getString(); }
+    Stream& stream() { return http_.getStream(); }
+    // Content-Length of the response, -1 when the body is chunked
+    int contentLength() { return http_.getSize(); }
+
+    // Ends the current response, keeping the socket open for the next request
+    void finish();
+    // Closes the socket, the next request will reconnect
+    void disconnect();
+
+    // Seconds Telegram asked us to back off for in the last 429 response
+    uint32_t retryAfter() const { return retryAfter_; }
+
+    uint32_t requests() const { return requests_; }
+    uint32_t handshakes() const { return handshakes_; }
+
+private:
+    void readRetryAfter();
+    int send(const char* type, const char* method, const String& query, FormBodyStream* body);
+
+    String host_;
+    uint16_t port_ = 443;
+    bool https_ = true;
+    String botPath_;
+    WiFiClient plainClient_;
+    WiFiClientSecure secureClient_;
+    WiFiClient* client_;        // one of the two, by the URL's scheme
+    HTTPClient http_;
+    uint16_t timeoutMs_ = 10000;
+    uint32_t requests_ = 0;
+    uint32_t handshakes_ = 0;
+    uint32_t retryAfter_ = 0;
+};
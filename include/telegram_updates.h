@@ -0,0 +1,255 @@
+#pragma once
+
+#include <stdint.h>
+#include <ArduinoJson.h>
+
+// Streaming parser for getUpdates responses.
+//
+// The response is read straight from the connection, one update at a time:
+// the parser skips to the "result" array and deserializes each element on its
+// own into a small fixed-size document, filtered down to the few fields the
+// command channel needs. Memory use is the same whether the response holds
+// one update or a thousand.
+//
+// Readers follow ArduinoJson's custom reader interface:
+//   int read();                                    // next byte or -1
+//   size_t readBytes(char* buffer, size_t length);
+
+// Per-update document. Covers the filtered fields plus a message text of
+// roughly 900 bytes; longer texts are reported as UPDATES_TOO_LARGE.
+#ifndef TELEGRAM_UPDATE_DOC_CAPACITY
+#define TELEGRAM_UPDATE_DOC_CAPACITY 1024
+#endif
+
+typedef StaticJsonDocument<TELEGRAM_UPDATE_DOC_CAPACITY> TelegramUpdateDocument;
+
+struct TelegramUpdate {
+    int32_t updateId;
+    uint32_t date;
+    const char* text;   // "" for non-text messages, only valid during the callback
+    bool isReply;       // message is a reply to another message
+};
+
+enum UpdatesParseResult {
+    UPDATES_OK,
+    UPDATES_BAD_RESPONSE,   // not a getUpdates result (error reply, garbage)
+    UPDATES_TRUNCATED,      // body ended or timed out mid-way
+    UPDATES_TOO_LARGE,      // one update did not fit TelegramUpdateDocument
+};
+
+struct UpdatesParseSummary {
+    UpdatesParseResult result;
+    int count;              // updates handed to the callback
+    int32_t lastUpdateId;   // of the last update handed to the callback
+    int32_t failedUpdateId; // UPDATES_TOO_LARGE only, -1 when it could not be read
+};
+
+// Only these fields survive deserialization. reply_to_message is reduced to
+// its message_id, which is enough to tell a reply from a plain message.
+inline JsonDocument& telegramUpdatesFilter() {
+    static StaticJsonDocument<256> filter;
+    if (filter.isNull()) {
+        filter["update_id"] = true;
+        JsonObject message = filter.createNestedObject("message");
+        message["date"] = true;
+        message["text"] = true;
+        message.createNestedObject("reply_to_message")["message_id"] = true;
+    }
+    return filter;
+}
+
+// One byte of pushback on top of any reader
+template <typename TReader>
+class PushbackReader {
+public:
+    explicit PushbackReader(TReader& reader) : reader_(reader) {}
+
+    int read() {
+        if (pending_ >= 0) {
+            int c = pending_;
+            pending_ = -1;
+            return c;
+        }
+        return reader_.read();
+    }
+
+    size_t readBytes(char* buffer, size_t length) {
+        size_t n = 0;
+        if (length > 0 && pending_ >= 0) {
+            buffer[n++] = (char)pending_;
+            pending_ = -1;
+        }
+        return n + reader_.readBytes(buffer + n, length - n);
+    }
+
+    void unread(int c) { pending_ = c; }
+
+private:
+    TReader& reader_;
+    int pending_ = -1;
+};
+
+// Decodes a Transfer-Encoding: chunked body on the fly
+template <typename TReader>
+class ChunkedReader {
+public:
+    explicit ChunkedReader(TReader& reader) : reader_(reader) {}
+
+    int read() {
+        if (remaining_ == 0 && !nextChunk()) {
+            return -1;
+        }
+        int c = reader_.read();
+        if (c >= 0) {
+            remaining_--;
+        }
+        return c;
+    }
+
+    size_t readBytes(char* buffer, size_t length) {
+        size_t n = 0;
+        while (n < length) {
+            int c = read();
+            if (c < 0) {
+                break;
+            }
+            buffer[n++] = (char)c;
+        }
+        return n;
+    }
+
+private:
+    bool nextChunk() {
+        if (done_) {
+            return false;
+        }
+        if (started_) {
+            // CRLF that ends the previous chunk
+            reader_.read();
+            reader_.read();
+        }
+        started_ = true;
+
+        // Hex size, optional ";extension", CRLF
+        uint32_t size = 0;
+        bool inExtension = false;
+        int c;
+        while ((c = reader_.read()) >= 0 && c != '\n') {
+            if (inExtension || c == '\r') {
+                continue;
+            }
+            if (c >= '0' && c <= '9') {
+                size = size * 16 + (c - '0');
+            } else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f') {
+                size = size * 16 + ((c | 0x20) - 'a' + 10);
+            } else {
+                inExtension = true;
+            }
+        }
+
+        if (c < 0 || size == 0) {
+            done_ = true;
+            return false;
+        }
+        remaining_ = size;
+        return true;
+    }
+
+    TReader& reader_;
+    uint32_t remaining_ = 0;
+    bool started_ = false;
+    bool done_ = false;
+};
+
+template <typename TReader>
+int skipJsonWhitespace(TReader& reader) {
+    int c;
+    do {
+        c = reader.read();
+    } while (c == ' ' || c == '\n' || c == '\r' || c == '\t');
+    return c;
+}
+
+// Consumes the reader up to and including token. False at end of input.
+template <typename TReader>
+bool skipPastToken(TReader& reader, const char* token) {
+    size_t matched = 0;
+    while (token[matched] != '\0') {
+        int c = reader.read();
+        if (c < 0) {
+            return false;
+        }
+        if (c == token[matched]) {
+            matched++;
+        } else {
+            // No prefix of the tokens we search for repeats, so restarting is enough
+            matched = c == token[0] ? 1 : 0;
+        }
+    }
+    return true;
+}
+
+// Parses a getUpdates response and calls onUpdate(const TelegramUpdate&) for
+// every update, in order. Stops at the end of the result array, so the rest
+// of the body is left in the reader.
+template <typename TReader, typename THandler>
+UpdatesParseSummary parseTelegramUpdates(TReader& source, TelegramUpdateDocument& doc, THandler onUpdate) {
+    UpdatesParseSummary summary = { UPDATES_OK, 0, -1, -1 };
+    PushbackReader<TReader> reader(source);
+
+    if (!skipPastToken(reader, "\"result\"")) {
+        summary.result = UPDATES_BAD_RESPONSE;
+        return summary;
+    }
+    int c = skipJsonWhitespace(reader);
+    if (c == ':') {
+        c = skipJsonWhitespace(reader);
+    }
+    if (c != '[') {
+        summary.result = c < 0 ? UPDATES_TRUNCATED : UPDATES_BAD_RESPONSE;
+        return summary;
+    }
+
+    for (;;) {
+        c = skipJsonWhitespace(reader);
+        if (c == ']') {
+            return summary;
+        }
+        if (c != '{') {
+            summary.result = c < 0 ? UPDATES_TRUNCATED : UPDATES_BAD_RESPONSE;
+            return summary;
+        }
+        reader.unread(c);
+
+        DeserializationError error = deserializeJson(doc, reader, DeserializationOption::Filter(telegramUpdatesFilter()));
+        if (error == DeserializationError::NoMemory) {
+            // update_id comes first in every update, so it is usually already in the document
+            summary.result = UPDATES_TOO_LARGE;
+            summary.failedUpdateId = doc["update_id"] | -1;
+            return summary;
+        }
+        if (error) {
+            summary.result = error == DeserializationError::IncompleteInput ? UPDATES_TRUNCATED : UPDATES_BAD_RESPONSE;
+            return summary;
+        }
+
+        JsonObject message = doc["message"];
+        TelegramUpdate update;
+        update.updateId = doc["update_id"];
+        update.date = message["date"] | 0;
+        update.text = message["text"] | "";
+        update.isReply = message.containsKey("reply_to_message");
+        onUpdate(update);
+        summary.count++;
+        summary.lastUpdateId = update.updateId;
+
+        c = skipJsonWhitespace(reader);
+        if (c == ']') {
+            return summary;
+        }
+        if (c != ',') {
+            summary.result = c < 0 ? UPDATES_TRUNCATED : UPDATES_BAD_RESPONSE;
+            return summary;
+        }
+    }
+}
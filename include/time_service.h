@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <esp_timer.h>
+
+// Wall-clock time without waiting for it.
+//
+// SNTP runs in the background and reports every sync through its callback,
+// which anchors the epoch to the monotonic esp_timer clock. Events only
+// record monotonic time when they happen; the anchor turns that into a date
+// when the event is rendered, so no code path ever waits for NTP and an
+// event raised before the first sync still gets the right time if it is
+// rendered afterwards.
+//
+// The anchor is also kept in RTC memory against the RTC timer, which keeps
+// counting through a soft reboot (watchdog, brownout, panic). After such a
+// reboot the clock is known again straight away, without the network. Only
+// a power loss starts from scratch.
+
+// How often SNTP re-syncs once it has a time
+#ifndef TIME_SYNC_INTERVAL_MS
+#define TIME_SYNC_INTERVAL_MS 300000
+#endif
+
+// How often the anchor in RTC memory is brought forward. The RTC timer runs
+// off a less accurate clock, so it should only ever bridge a short stretch.
+#ifndef TIME_PERSIST_INTERVAL_MS
+#define TIME_PERSIST_INTERVAL_MS 10000
+#endif
+
+// An instant that outlives this boot, for events stored in flash. Epoch
+// milliseconds when the clock was known, otherwise milliseconds on the RTC
+// timer of the current power-up, which can still be placed once it is.
+struct StoredTime {
+    int64_t ms;
+    uint32_t session;   // 0: ms is epoch time, else the power-up it belongs to
+};
+
+struct TimeServiceStats {
+    uint32_t syncs;
+    int32_t lastCorrection_ms;  // anchored clock minus NTP time at the last sync
+    uint32_t lastSyncAge_s;     // since the last sync, 0 before the first one
+    bool restored;              // anchor carried over from before a soft reboot
+};
+
+// Monotonic microseconds since boot, cheap enough for any event path
+inline int64_t monotonicMicros() {
+    return esp_timer_get_time();
+}
+
+// Starts SNTP and restores the anchor from RTC memory, returns immediately.
+// Safe to call before WiFi is up.
+void startTimeService(const char* server, long gmtOffsetSec, int daylightOffsetSec);
+
+// Asks for a sync now instead of at the next interval, e.g. after an outage
+void requestTimeSync();
+
+// Refreshes the anchor in RTC memory every TIME_PERSIST_INTERVAL_MS. Call from loop().
+void persistTimeAnchor();
+
+// True once the clock is known, from SNTP or restored after a soft reboot
+bool timeSynced();
+
+// Seconds since the epoch at the given monotonic instant, false before the first sync
+bool epochAt(int64_t monotonic_us, time_t* epoch);
+
+// Local "dd/mm/yyyy hh:mm:ss" at the given monotonic instant. False before the
+// first sync, the buffer is left alone then.
+bool formatTimestamp(int64_t monotonic_us, char* buffer, size_t size);
+
+StoredTime storedTimeAt(int64_t monotonic_us);
+
+// Local "dd/mm/yyyy hh:mm:ss" of a stored instant. False while it cannot be
+// placed: the clock is still unknown, or it is from before a power loss.
+bool formatStoredTime(const StoredTime& time, char* buffer, size_t size);
+
+TimeServiceStats getTimeServiceStats();
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+
+// Token bucket on a millisecond clock, paces outgoing messages.
+//
+// Holds up to burst tokens and gains one every intervalMs. pause() empties it
+// and holds refills back, for when the server asks us to slow down.
+class TokenBucket {
+public:
+    TokenBucket(uint8_t burst, uint32_t intervalMs)
+        : burst_(burst), intervalMs_(intervalMs), tokens_(burst) {}
+
+    // Milliseconds until a token is available, 0 when one is available now
+    uint32_t wait(uint32_t nowMs) {
+        refill(nowMs);
+        if (tokens_ > 0) {
+            return 0;
+        }
+        return (uint32_t)((int32_t)intervalMs_ - (int32_t)(nowMs - lastRefill_));
+    }
+
+    // Uses up one token, call only once wait() returned 0
+    void take(uint32_t nowMs) {
+        refill(nowMs);
+        if (tokens_ > 0) {
+            if (tokens_ == burst_) {
+                lastRefill_ = nowMs;
+            }
+            tokens_--;
+        }
+    }
+
+    // No tokens for the next ms milliseconds, then refills resume one by one
+    void pause(uint32_t nowMs, uint32_t ms) {
+        tokens_ = 0;
+        lastRefill_ = nowMs + ms - intervalMs_;
+    }
+
+    uint8_t tokens() const { return tokens_; }
+
+private:
+    void refill(uint32_t nowMs) {
+        // Negative while a pause() is in effect
+        int32_t elapsed = (int32_t)(nowMs - lastRefill_);
+        if (tokens_ >= burst_ || elapsed < (int32_t)intervalMs_) {
+            return;
+        }
+        uint32_t gained = (uint32_t)elapsed / intervalMs_;
+        if (gained >= (uint32_t)(burst_ - tokens_)) {
+            tokens_ = burst_;
+        } else {
+            tokens_ += gained;
+        }
+        lastRefill_ += gained * intervalMs_;
+    }
+
+    uint8_t burst_;
+    uint32_t intervalMs_;
+    uint8_t tokens_;
+    uint32_t lastRefill_ = 0;
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// application/x-www-form-urlencoded encoding, same output as the old
+// urlEncode(): letters and digits pass through, space becomes '+', every
+// other byte becomes %XX.
+//
+// The per-byte output width comes from a table, so the exact encoded size of
+// a message is known before anything is written and the text can be encoded
+// straight into the outgoing request.
+
+static const uint8_t urlEncodedWidth[256] = {
+    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+    1, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 3, 3, 3, 3, 3, 3,
+    3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 3, 3, 3, 3, 3,
+    3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 3, 3, 3, 3, 3,
+    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+};
+
+inline size_t urlEncodedLength(const char* text, size_t length) {
+    size_t encoded = 0;
+    for (size_t i = 0; i < length; i++) {
+        encoded += urlEncodedWidth[(uint8_t)text[i]];
+    }
+    return encoded;
+}
+
+// Writes the encoding of c to out (room for 3 bytes) and returns its length
+inline size_t urlEncodeByte(uint8_t c, char* out) {
+    static const char hexDigits[] = "0123456789ABCDEF";
+    if (urlEncodedWidth[c] == 1) {
+        out[0] = c == ' ' ? '+' : (char)c;
+        return 1;
+    }
+    out[0] = '%';
+    out[1] = hexDigits[c >> 4];
+    out[2] = hexDigits[c & 0xf];
+    return 3;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdint.h>
+
+// Non-blocking WiFi connection manager.
+//
+// The WiFi driver reports link changes through its event callbacks; loop()
+// calls serviceWifi() once per iteration, which only compares timestamps and
+// flags and at most starts a connection attempt with WiFi.begin(). Failed
+// attempts and dropped links are retried with exponential backoff plus
+// jitter, so a missing access point is not hammered every second.
+
+// First retry delay, doubled after every failed attempt up to the maximum
+#ifndef WIFI_BACKOFF_MIN_MS
+#define WIFI_BACKOFF_MIN_MS 1000
+#endif
+
+#ifndef WIFI_BACKOFF_MAX_MS
+#define WIFI_BACKOFF_MAX_MS 60000
+#endif
+
+// An attempt that has not produced an IP address by then counts as failed
+#ifndef WIFI_CONNECT_TIMEOUT_MS
+#define WIFI_CONNECT_TIMEOUT_MS 15000
+#endif
+
+enum WifiTransition : uint8_t {
+    WIFI_NO_CHANGE,
+    WIFI_LINK_UP,       // connected and got an IP address
+    WIFI_LINK_DOWN,     // lost the connection
+};
+
+struct WifiStats {
+    uint32_t attempts;              // WiFi.begin() calls
+    uint32_t failedAttempts;        // attempts that ended in a disconnect or timed out
+    uint32_t connects;
+    uint32_t disconnects;
+    uint32_t outageAttempts;        // attempts since the link went down, 0 while connected
+    uint32_t lastReconnectMs;       // link lost (or boot) to IP address, last time
+    uint32_t maxReconnectMs;
+    uint64_t offlineMs;             // total time without a connection, including right now
+    uint32_t backoffMs;             // delay before the next attempt
+    uint8_t lastDisconnectReason;   // as reported by the driver
+};
+
+// Registers the event handler and starts the first attempt
+void startWifi(const char* ssid, const char* password);
+
+// Advances the state machine, never blocks. Call from loop().
+WifiTransition serviceWifi();
+
+bool wifiConnected();
+
+WifiStats getWifiStats();
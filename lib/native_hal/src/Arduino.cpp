@@ -0,0 +1,230 @@
+#include <Arduino.h>
+#include "native_hal.h"
+
+HardwareSerial Serial;
+
+#if defined(__GLIBC__) && !__GLIBC_PREREQ(2, 38)
+size_t strlcpy(char* dst, const char* src, size_t size) {
+    size_t length = strlen(src);
+    if (size > 0) {
+        size_t n = length < size - 1 ? length : size - 1;
+        memcpy(dst, src, n);
+        dst[n] = '\0';
+    }
+    return length;
+}
+#endif
+
+// --- Time ---
+
+unsigned long millis() {
+    return (uint32_t)(halClock().nowMicros() / 1000);
+}
+
+unsigned long micros() {
+    return (uint32_t)halClock().nowMicros();
+}
+
+void delay(uint32_t ms) {
+    halClock().sleepMicros((int64_t)ms * 1000);
+}
+
+void delayMicroseconds(uint32_t us) {
+    halClock().sleepMicros(us);
+}
+
+void yield() {
+    halClock().sleepMicros(0);
+}
+
+// --- GPIO ---
+
+static const uint8_t pinCount = 40;
+
+struct HalPin {
+    uint8_t mode;
+    int level;
+    bool driven;                // set by halWritePin(), otherwise the pull decides
+    void (*handler)(void);
+    int interruptMode;
+};
+
+static HalPin pins[pinCount];
+static portMUX_TYPE gpioLock = portMUX_INITIALIZER_UNLOCKED;
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    if (pin >= pinCount) {
+        return;
+    }
+    portENTER_CRITICAL(&gpioLock);
+    pins[pin].mode = mode;
+    if (!pins[pin].driven) {
+        pins[pin].level = (mode & PULLUP) ? HIGH : LOW;
+    }
+    portEXIT_CRITICAL(&gpioLock);
+}
+
+int digitalRead(uint8_t pin) {
+    if (pin >= pinCount) {
+        return LOW;
+    }
+    portENTER_CRITICAL(&gpioLock);
+    int level = pins[pin].level;
+    portEXIT_CRITICAL(&gpioLock);
+    return level;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+    halWritePin(pin, value);
+}
+
+void attachInterrupt(uint8_t pin, void (*handler)(void), int mode) {
+    if (pin >= pinCount) {
+        return;
+    }
+    portENTER_CRITICAL(&gpioLock);
+    pins[pin].handler = handler;
+    pins[pin].interruptMode = mode;
+    portEXIT_CRITICAL(&gpioLock);
+}
+
+void detachInterrupt(uint8_t pin) {
+    attachInterrupt(pin, nullptr, 0);
+}
+
+void halWritePin(uint8_t pin, int level) {
+    if (pin >= pinCount) {
+        return;
+    }
+    level = level ? HIGH : LOW;
+    portENTER_CRITICAL(&gpioLock);
+    HalPin& state = pins[pin];
+    bool rising = level == HIGH && state.level == LOW;
+    bool falling = level == LOW && state.level == HIGH;
+    state.level = level;
+    state.driven = true;
+    if (state.handler && ((rising && (state.interruptMode & RISING)) || (falling && (state.interruptMode & FALLING)))) {
+        state.handler();
+    }
+    portEXIT_CRITICAL(&gpioLock);
+}
+
+int halReadPin(uint8_t pin) {
+    return digitalRead(pin);
+}
+
+// --- Random numbers, from esp_random() as on the board ---
+
+long random(long howBig) {
+    return howBig > 0 ? (long)(esp_random() % (uint32_t)howBig) : 0;
+}
+
+long random(long howSmall, long howBig) {
+    return howSmall >= howBig ? howSmall : howSmall + random(howBig - howSmall);
+}
+
+// --- String ---
+
+int String::indexOf(char c, unsigned int from) const {
+    size_t found = text_.find(c, from);
+    return found == std::string::npos ? -1 : (int)found;
+}
+
+int String::indexOf(const char* text, unsigned int from) const {
+    size_t found = text_.find(text, from);
+    return found == std::string::npos ? -1 : (int)found;
+}
+
+String String::substring(unsigned int from, unsigned int to) const {
+    if (from >= text_.length() || to <= from) {
+        return String();
+    }
+    return String(text_.substr(from, to - from));
+}
+
+bool String::startsWith(const char* prefix) const {
+    return text_.compare(0, strlen(prefix), prefix) == 0;
+}
+
+bool String::endsWith(const char* suffix) const {
+    size_t length = strlen(suffix);
+    return text_.length() >= length && text_.compare(text_.length() - length, length, suffix) == 0;
+}
+
+// --- Print / Stream ---
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+    size_t n = 0;
+    while (n < size && write(buffer[n])) {
+        n++;
+    }
+    return n;
+}
+
+size_t Print::printf(const char* format, ...) {
+    char small[256];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(small, sizeof(small), format, args);
+    va_end(args);
+    if (length < 0) {
+        return 0;
+    }
+    if ((size_t)length < sizeof(small)) {
+        return write((const uint8_t*)small, length);
+    }
+
+    std::string large(length + 1, '\0');
+    va_start(args, format);
+    vsnprintf(&large[0], large.size(), format, args);
+    va_end(args);
+    return write((const uint8_t*)large.data(), length);
+}
+
+size_t Stream::readBytes(char* buffer, size_t length) {
+    size_t n = 0;
+    while (n < length) {
+        int c = read();
+        if (c < 0) {
+            break;
+        }
+        buffer[n++] = (char)c;
+    }
+    return n;
+}
+
+String Stream::readString() {
+    std::string text;
+    int c;
+    while ((c = read()) >= 0) {
+        text += (char)c;
+    }
+    return String(text);
+}
+
+static FILE* serialOutput = stdout;
+
+void halSetSerialOutput(FILE* out) {
+    serialOutput = out;
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+    if (!serialOutput) {
+        return 1;
+    }
+    return fputc(c, serialOutput) == EOF ? 0 : 1;
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+    if (!serialOutput) {
+        return size;
+    }
+    // One call per print, so lines from different tasks do not interleave
+    return fwrite(buffer, 1, size, serialOutput);
+}
+
+void HardwareSerial::flush() {
+    if (serialOutput) {
+        fflush(serialOutput);
+    }
+}
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+#include <algorithm>
+#include <string>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_system.h"
+
+// The part of the Arduino-ESP32 core the firmware uses, see native_hal.h
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define RTC_NOINIT_ATTR
+
+#define LOW 0x0
+#define HIGH 0x1
+
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define PULLUP 0x04
+#define INPUT_PULLUP 0x05
+#define PULLDOWN 0x08
+#define INPUT_PULLDOWN 0x09
+
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+
+#define digitalPinToInterrupt(p) (p)
+
+using std::min;
+using std::max;
+
+#if defined(__GLIBC__) && !__GLIBC_PREREQ(2, 38)
+size_t strlcpy(char* dst, const char* src, size_t size);
+#endif
+
+void setup();
+void loop();
+
+// Both wrap at 32 bits as on the board, so overflow bugs show up here too
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t value);
+void attachInterrupt(uint8_t pin, void (*handler)(void), int mode);
+void detachInterrupt(uint8_t pin);
+
+long random(long howBig);
+long random(long howSmall, long howBig);
+
+void configTime(long gmtOffset_sec, int daylightOffset_sec, const char* server1,
+                const char* server2 = nullptr, const char* server3 = nullptr);
+
+class String {
+public:
+    String() {}
+    String(const char* text) : text_(text ? text : "") {}
+    String(const std::string& text) : text_(text) {}
+    explicit String(char c) : text_(1, c) {}
+    explicit String(int value) : text_(std::to_string(value)) {}
+    explicit String(unsigned int value) : text_(std::to_string(value)) {}
+    explicit String(long value) : text_(std::to_string(value)) {}
+    explicit String(unsigned long value) : text_(std::to_string(value)) {}
+    explicit String(long long value) : text_(std::to_string(value)) {}
+    explicit String(unsigned long long value) : text_(std::to_string(value)) {}
+
+    const char* c_str() const { return text_.c_str(); }
+    unsigned int length() const { return (unsigned int)text_.length(); }
+    bool isEmpty() const { return text_.empty(); }
+    char operator[](unsigned int index) const { return index < text_.length() ? text_[index] : 0; }
+    int indexOf(char c, unsigned int from = 0) const;
+    int indexOf(const char* text, unsigned int from = 0) const;
+    String substring(unsigned int from, unsigned int to = (unsigned int)-1) const;
+    bool startsWith(const char* prefix) const;
+    bool endsWith(const char* suffix) const;
+    bool equalsIgnoreCase(const String& other) const { return strcasecmp(text_.c_str(), other.c_str()) == 0; }
+    long toInt() const { return strtol(text_.c_str(), nullptr, 10); }
+
+    bool reserve(unsigned int size) { text_.reserve(size); return true; }
+    bool concat(const char* text, unsigned int length) { text_.append(text, length); return true; }
+
+    String& operator+=(const String& other) { text_ += other.text_; return *this; }
+    String& operator+=(const char* text) { text_ += text; return *this; }
+    String& operator+=(char c) { text_ += c; return *this; }
+
+    bool operator==(const String& other) const { return text_ == other.text_; }
+    bool operator==(const char* text) const { return text_ == text; }
+    bool operator!=(const String& other) const { return text_ != other.text_; }
+    bool operator!=(const char* text) const { return text_ != text; }
+
+    const std::string& str() const { return text_; }
+
+private:
+    std::string text_;
+};
+
+inline String operator+(const String& a, const String& b) { String s(a); s += b; return s; }
+inline String operator+(const String& a, const char* b) { String s(a); s += b; return s; }
+inline String operator+(const char* a, const String& b) { String s(a); s += b; return s; }
+inline String operator+(const String& a, char b) { String s(a); s += b; return s; }
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size);
+    size_t write(const char* text) { return text ? write((const uint8_t*)text, strlen(text)) : 0; }
+    virtual void flush() {}
+
+    size_t print(const char* text) { return write(text); }
+    size_t print(const String& text) { return write(text.c_str()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(int value) { return printf("%d", value); }
+    size_t print(unsigned int value) { return printf("%u", value); }
+    size_t print(long value) { return printf("%ld", value); }
+    size_t print(unsigned long value) { return printf("%lu", value); }
+    size_t println() { return write("\r\n"); }
+    template <typename T>
+    size_t println(const T& value) { return print(value) + println(); }
+
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+
+    void setTimeout(unsigned long timeout) { timeout_ = timeout; }
+    unsigned long getTimeout() const { return timeout_; }
+
+    // Host streams hold all their data already, read() == -1 is the end
+    size_t readBytes(char* buffer, size_t length);
+    size_t readBytes(uint8_t* buffer, size_t length) { return readBytes((char*)buffer, length); }
+    String readString();
+
+protected:
+    unsigned long timeout_ = 1000;
+};
+
+// Prints to stdout, reads nothing
+class HardwareSerial : public Stream {
+public:
+    void begin(unsigned long baud) { (void)baud; }
+    void end() {}
+
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+    void flush() override;
+};
+
+extern HardwareSerial Serial;
@@ -0,0 +1,94 @@
+#include <sys/stat.h>
+#include <FS.h>
+#include <SPIFFS.h>
+#include "native_hal.h"
+
+fs::SPIFFSFS SPIFFS;
+
+namespace fs {
+
+File::File(FILE* file, const char* path) : file_(file, fclose), path_(path) {
+}
+
+size_t File::write(uint8_t c) {
+    return file_ && fputc(c, file_.get()) != EOF ? 1 : 0;
+}
+
+size_t File::write(const uint8_t* buffer, size_t size) {
+    return file_ ? fwrite(buffer, 1, size, file_.get()) : 0;
+}
+
+void File::flush() {
+    if (file_) {
+        fflush(file_.get());
+    }
+}
+
+int File::available() {
+    return file_ ? (int)(size() - position()) : 0;
+}
+
+int File::read() {
+    return file_ ? fgetc(file_.get()) : -1;
+}
+
+int File::peek() {
+    if (!file_) {
+        return -1;
+    }
+    int c = fgetc(file_.get());
+    if (c != EOF) {
+        ungetc(c, file_.get());
+    }
+    return c;
+}
+
+size_t File::read(uint8_t* buffer, size_t size) {
+    return file_ ? fread(buffer, 1, size, file_.get()) : 0;
+}
+
+bool File::seek(uint32_t position, SeekMode mode) {
+    static const int whence[] = { SEEK_SET, SEEK_CUR, SEEK_END };
+    return file_ && fseek(file_.get(), position, whence[mode]) == 0;
+}
+
+size_t File::position() const {
+    if (!file_) {
+        return 0;
+    }
+    long position = ftell(file_.get());
+    return position < 0 ? 0 : (size_t)position;
+}
+
+size_t File::size() const {
+    struct stat info;
+    return file_ && fstat(fileno(file_.get()), &info) == 0 ? (size_t)info.st_size : 0;
+}
+
+void File::close() {
+    file_.reset();
+}
+
+File FS::open(const char* path, const char* mode, bool create) {
+    (void)create;
+    std::string hostPath = halFilesystemPath(path);
+    // Same modes as SPIFFS, always binary
+    std::string hostMode = std::string(mode) + "b";
+    FILE* file = fopen(hostPath.c_str(), hostMode.c_str());
+    return file ? File(file, path) : File();
+}
+
+bool FS::exists(const char* path) {
+    struct stat info;
+    return stat(halFilesystemPath(path).c_str(), &info) == 0;
+}
+
+bool FS::remove(const char* path) {
+    return ::remove(halFilesystemPath(path).c_str()) == 0;
+}
+
+bool FS::rename(const char* pathFrom, const char* pathTo) {
+    return ::rename(halFilesystemPath(pathFrom).c_str(), halFilesystemPath(pathTo).c_str()) == 0;
+}
+
+}  // namespace fs
@@ -0,0 +1,92 @@
+#include <HTTPClient.h>
+
+bool HTTPClient::begin(WiFiClient& client, const String& host, uint16_t port, const String& uri, bool https) {
+    client_ = &client;
+    request_ = HalHttpRequest();
+    request_.host = host.str();
+    request_.port = port;
+    request_.https = https;
+    request_.path = uri.str();
+    size_ = -1;
+    return true;
+}
+
+void HTTPClient::end() {
+    if (client_ && !reuse_) {
+        client_->stop();
+    }
+    request_.headers.clear();
+}
+
+void HTTPClient::addHeader(const String& name, const String& value, bool first, bool replace) {
+    (void)first;
+    if (replace || request_.headers.find(name.str()) == request_.headers.end()) {
+        request_.headers[name.str()] = value.str();
+    }
+}
+
+int HTTPClient::sendRequest(const char* type, const String& payload) {
+    return send(type, payload.str());
+}
+
+int HTTPClient::sendRequest(const char* type, const uint8_t* payload, size_t size) {
+    return send(type, payload ? std::string((const char*)payload, size) : std::string());
+}
+
+int HTTPClient::sendRequest(const char* type, Stream* stream, size_t size) {
+    if (!stream) {
+        return HTTPC_ERROR_NO_STREAM;
+    }
+    // Pulled the way the real client does, so stream bodies are exercised too
+    std::string body;
+    char buffer[128];
+    while (size == 0 || body.size() < size) {
+        size_t want = size == 0 ? sizeof(buffer) : std::min(sizeof(buffer), size - body.size());
+        size_t n = stream->readBytes(buffer, want);
+        if (n == 0) {
+            break;
+        }
+        body.append(buffer, n);
+    }
+    if (size != 0 && body.size() != size) {
+        return HTTPC_ERROR_SEND_PAYLOAD_FAILED;
+    }
+    return send(type, body);
+}
+
+int HTTPClient::send(const char* type, const std::string& body) {
+    if (!client_) {
+        return HTTPC_ERROR_NOT_CONNECTED;
+    }
+    // A socket opened before the link went down only fails once it is used
+    if (client_->connected() && client_->halLinkLost()) {
+        client_->stop();
+        return HTTPC_ERROR_CONNECTION_LOST;
+    }
+    request_.reused = client_->connected();
+    if (!request_.reused) {
+        if (!WiFi.isConnected()) {
+            return HTTPC_ERROR_CONNECTION_REFUSED;
+        }
+        client_->halOpen(halWifiLinkGeneration());
+    }
+
+    request_.method = type;
+    request_.body = body;
+    request_.timeoutMs = timeout_;
+    request_.connection = client_;
+    HalHttpResponse response;
+    int code = halHttp().request(request_, response);
+    if (code <= 0) {
+        client_->stop();
+        return code;
+    }
+    // A body cut short reads to its end, then the socket is closed
+    client_->halSetResponse(response.body, reuse_ && response.keepAlive && response.missing == 0);
+    size_ = response.chunked ? -1 : (int)(response.body.size() + response.missing);
+    return code;
+}
+
+String HTTPClient::getString() {
+    return client_ ? client_->readString() : String();
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include "native_hal.h"
+
+// HTTPClient over halHttp(), see native_hal.h. The whole request is handed
+// to the backend at once, the response body is read back from the client
+// passed to begin().
+
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+#define HTTPC_ERROR_SEND_HEADER_FAILED (-2)
+#define HTTPC_ERROR_SEND_PAYLOAD_FAILED (-3)
+#define HTTPC_ERROR_NOT_CONNECTED (-4)
+#define HTTPC_ERROR_CONNECTION_LOST (-5)
+#define HTTPC_ERROR_NO_STREAM (-6)
+#define HTTPC_ERROR_NO_HTTP_SERVER (-7)
+#define HTTPC_ERROR_TOO_LESS_RAM (-8)
+#define HTTPC_ERROR_ENCODING (-9)
+#define HTTPC_ERROR_STREAM_WRITE (-10)
+#define HTTPC_ERROR_READ_TIMEOUT (-11)
+
+class HTTPClient {
+public:
+    bool begin(WiFiClient& client, const String& host, uint16_t port, const String& uri = "/", bool https = false);
+    void end();
+
+    void setReuse(bool reuse) { reuse_ = reuse; }
+    void setTimeout(uint16_t timeout) { timeout_ = timeout; }
+    void addHeader(const String& name, const String& value, bool first = false, bool replace = true);
+
+    int sendRequest(const char* type, const String& payload);
+    int sendRequest(const char* type, const uint8_t* payload = nullptr, size_t size = 0);
+    int sendRequest(const char* type, Stream* stream, size_t size = 0);
+    int GET() { return sendRequest("GET"); }
+    int POST(const String& payload) { return sendRequest("POST", payload); }
+
+    String getString();
+    WiFiClient& getStream() { return *client_; }
+    WiFiClient* getStreamPtr() { return client_; }
+    // Content-Length of the response, -1 when it is chunked
+    int getSize() { return size_; }
+
+private:
+    int send(const char* type, const std::string& body);
+
+    WiFiClient* client_ = nullptr;
+    HalHttpRequest request_;
+    bool reuse_ = true;
+    uint16_t timeout_ = 5000;
+    int size_ = -1;
+};
@@ -0,0 +1,121 @@
+#include <map>
+#include <mutex>
+#include <Preferences.h>
+
+typedef std::map<std::string, std::string> NvsNamespace;
+
+static std::mutex nvsLock;
+static std::map<std::string, NvsNamespace> nvs;
+
+bool Preferences::begin(const char* name, bool readOnly, const char* partitionLabel) {
+    (void)partitionLabel;
+    namespace_ = name;
+    readOnly_ = readOnly;
+    open_ = true;
+    return true;
+}
+
+void Preferences::end() {
+    open_ = false;
+}
+
+bool Preferences::clear() {
+    if (!open_ || readOnly_) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(nvsLock);
+    nvs[namespace_].clear();
+    return true;
+}
+
+bool Preferences::remove(const char* key) {
+    if (!open_ || readOnly_) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(nvsLock);
+    return nvs[namespace_].erase(key) > 0;
+}
+
+bool Preferences::isKey(const char* key) {
+    if (!open_) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(nvsLock);
+    return nvs[namespace_].count(key) > 0;
+}
+
+size_t Preferences::putBytes(const char* key, const void* value, size_t length) {
+    if (!open_ || readOnly_) {
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(nvsLock);
+    nvs[namespace_][key] = std::string((const char*)value, length);
+    return length;
+}
+
+size_t Preferences::putInt(const char* key, int32_t value) {
+    return putBytes(key, &value, sizeof(value));
+}
+
+size_t Preferences::putUInt(const char* key, uint32_t value) {
+    return putBytes(key, &value, sizeof(value));
+}
+
+size_t Preferences::putBool(const char* key, bool value) {
+    uint8_t stored = value ? 1 : 0;
+    return putBytes(key, &stored, sizeof(stored));
+}
+
+// Only a value stored with the same size is returned, like NVS types
+bool Preferences::get(const char* key, void* value, size_t length) {
+    if (!open_) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(nvsLock);
+    const NvsNamespace& values = nvs[namespace_];
+    NvsNamespace::const_iterator found = values.find(key);
+    if (found == values.end() || found->second.size() != length) {
+        return false;
+    }
+    memcpy(value, found->second.data(), length);
+    return true;
+}
+
+int32_t Preferences::getInt(const char* key, int32_t defaultValue) {
+    int32_t value;
+    return get(key, &value, sizeof(value)) ? value : defaultValue;
+}
+
+uint32_t Preferences::getUInt(const char* key, uint32_t defaultValue) {
+    uint32_t value;
+    return get(key, &value, sizeof(value)) ? value : defaultValue;
+}
+
+bool Preferences::getBool(const char* key, bool defaultValue) {
+    uint8_t value;
+    return get(key, &value, sizeof(value)) ? value != 0 : defaultValue;
+}
+
+size_t Preferences::getBytesLength(const char* key) {
+    if (!open_) {
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(nvsLock);
+    const NvsNamespace& values = nvs[namespace_];
+    NvsNamespace::const_iterator found = values.find(key);
+    return found == values.end() ? 0 : found->second.size();
+}
+
+size_t Preferences::getBytes(const char* key, void* buffer, size_t maxLength) {
+    if (!open_) {
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(nvsLock);
+    const NvsNamespace& values = nvs[namespace_];
+    NvsNamespace::const_iterator found = values.find(key);
+    if (found == values.end() || found->second.size() > maxLength) {
+        return 0;
+    }
+    memcpy(buffer, found->second.data(), found->second.size());
+    return found->second.size();
+}
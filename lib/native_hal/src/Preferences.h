@@ -0,0 +1,32 @@
+#pragma once
+
+#include <Arduino.h>
+
+// NVS namespaces, kept in memory for the life of the process
+class Preferences {
+public:
+    bool begin(const char* name, bool readOnly = false, const char* partitionLabel = nullptr);
+    void end();
+
+    bool clear();
+    bool remove(const char* key);
+    bool isKey(const char* key);
+
+    size_t putInt(const char* key, int32_t value);
+    size_t putUInt(const char* key, uint32_t value);
+    size_t putBool(const char* key, bool value);
+    size_t putBytes(const char* key, const void* value, size_t length);
+
+    int32_t getInt(const char* key, int32_t defaultValue = 0);
+    uint32_t getUInt(const char* key, uint32_t defaultValue = 0);
+    bool getBool(const char* key, bool defaultValue = false);
+    size_t getBytesLength(const char* key);
+    size_t getBytes(const char* key, void* buffer, size_t maxLength);
+
+private:
+    bool get(const char* key, void* value, size_t length);
+
+    std::string namespace_;
+    bool open_ = false;
+    bool readOnly_ = false;
+};
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <FS.h>
+
+namespace fs {
+
+// Always mounts, the files live in the host directory
+class SPIFFSFS : public FS {
+public:
+    bool begin(bool formatOnFail = false, const char* basePath = "/spiffs", uint8_t maxOpenFiles = 10,
+               const char* partitionLabel = nullptr) {
+        (void)formatOnFail;
+        (void)basePath;
+        (void)maxOpenFiles;
+        (void)partitionLabel;
+        return true;
+    }
+    void end() {}
+};
+
+}  // namespace fs
+
+extern fs::SPIFFSFS SPIFFS;
@@ -0,0 +1,198 @@
+#include <deque>
+#include <vector>
+#include <WiFi.h>
+#include "native_hal.h"
+
+WiFiClass WiFi;
+
+// How long joining the access point takes
+static const int64_t joinMicros = 300000;
+
+struct WifiEvent {
+    arduino_event_id_t id;
+    arduino_event_info_t info;
+};
+
+struct WifiHandler {
+    WiFiEventFuncCb callback;
+    arduino_event_id_t event;
+};
+
+static std::mutex wifiLock;
+static std::condition_variable eventPosted;
+static std::deque<WifiEvent> events;
+static std::vector<WifiHandler> handlers;
+static bool eventTaskStarted = false;
+
+static bool apAvailable = true;
+static bool hasIp = false;
+static uint32_t attempt = 0;            // moves on with every begin() and disconnect()
+static uint32_t linkGeneration = 0;
+
+// Call with wifiLock held
+static void postEvent(arduino_event_id_t id, uint8_t reason = 0) {
+    WifiEvent event = {};
+    event.id = id;
+    event.info.wifi_sta_disconnected.reason = reason;
+    events.push_back(event);
+    halClock().notifyAll(eventPosted);
+}
+
+// Call with wifiLock held
+static void dropLink(uint8_t reason) {
+    hasIp = false;
+    linkGeneration++;
+    postEvent(ARDUINO_EVENT_WIFI_STA_DISCONNECTED, reason);
+}
+
+static void eventTask() {
+    std::unique_lock<std::mutex> lock(wifiLock);
+    for (;;) {
+        while (events.empty()) {
+            halClock().waitMicros(lock, eventPosted, -1);
+        }
+        WifiEvent event = events.front();
+        events.pop_front();
+        std::vector<WifiHandler> current = handlers;
+
+        lock.unlock();
+        for (const WifiHandler& handler : current) {
+            if (handler.event == ARDUINO_EVENT_MAX || handler.event == event.id) {
+                handler.callback(event.id, event.info);
+            }
+        }
+        lock.lock();
+    }
+}
+
+// Call with wifiLock held
+static void startEventTask() {
+    if (!eventTaskStarted) {
+        eventTaskStarted = true;
+        halClock().spawn(eventTask);
+    }
+}
+
+static void joinTask(uint32_t joining) {
+    halClock().sleepMicros(joinMicros);
+
+    std::lock_guard<std::mutex> lock(wifiLock);
+    if (attempt != joining) {
+        return;
+    }
+    if (apAvailable) {
+        hasIp = true;
+        postEvent(ARDUINO_EVENT_WIFI_STA_CONNECTED);
+        postEvent(ARDUINO_EVENT_WIFI_STA_GOT_IP);
+    } else {
+        postEvent(ARDUINO_EVENT_WIFI_STA_DISCONNECTED, WIFI_REASON_NO_AP_FOUND);
+    }
+}
+
+void halSetWifiAvailable(bool available) {
+    std::lock_guard<std::mutex> lock(wifiLock);
+    apAvailable = available;
+    if (!available && hasIp) {
+        dropLink(WIFI_REASON_BEACON_TIMEOUT);
+    }
+}
+
+uint32_t halWifiLinkGeneration() {
+    std::lock_guard<std::mutex> lock(wifiLock);
+    return linkGeneration;
+}
+
+String IPAddress::toString() const {
+    char text[16];
+    snprintf(text, sizeof(text), "%u.%u.%u.%u", (unsigned)(address_ & 0xFF), (unsigned)(address_ >> 8 & 0xFF),
+             (unsigned)(address_ >> 16 & 0xFF), (unsigned)(address_ >> 24));
+    return String(text);
+}
+
+bool WiFiClass::mode(wifi_mode_t mode) {
+    (void)mode;
+    std::lock_guard<std::mutex> lock(wifiLock);
+    startEventTask();
+    return true;
+}
+
+bool WiFiClass::setAutoReconnect(bool autoReconnect) {
+    (void)autoReconnect;
+    return true;
+}
+
+wifi_event_id_t WiFiClass::onEvent(WiFiEventFuncCb callback, arduino_event_id_t event) {
+    std::lock_guard<std::mutex> lock(wifiLock);
+    WifiHandler handler = { callback, event };
+    handlers.push_back(handler);
+    return handlers.size();
+}
+
+wl_status_t WiFiClass::begin(const char* ssid, const char* passphrase) {
+    (void)ssid;
+    (void)passphrase;
+    std::lock_guard<std::mutex> lock(wifiLock);
+    startEventTask();
+    uint32_t joining = ++attempt;
+    halClock().spawn([joining]() { joinTask(joining); });
+    return WL_DISCONNECTED;
+}
+
+bool WiFiClass::disconnect(bool wifiOff, bool eraseAp) {
+    (void)wifiOff;
+    (void)eraseAp;
+    std::lock_guard<std::mutex> lock(wifiLock);
+    attempt++;
+    if (hasIp) {
+        dropLink(WIFI_REASON_ASSOC_LEAVE);
+    }
+    return true;
+}
+
+bool WiFiClass::isConnected() {
+    std::lock_guard<std::mutex> lock(wifiLock);
+    return hasIp;
+}
+
+wl_status_t WiFiClass::status() {
+    return isConnected() ? WL_CONNECTED : WL_DISCONNECTED;
+}
+
+IPAddress WiFiClass::localIP() {
+    return isConnected() ? IPAddress(192, 168, 1, 50) : IPAddress();
+}
+
+void WiFiClient::stop() {
+    if (connected_) {
+        halHttp().close(this);
+    }
+    connected_ = false;
+    response_.clear();
+    position_ = 0;
+}
+
+int WiFiClient::read() {
+    return position_ < response_.size() ? (uint8_t)response_[position_++] : -1;
+}
+
+int WiFiClient::peek() {
+    return position_ < response_.size() ? (uint8_t)response_[position_] : -1;
+}
+
+void WiFiClient::halOpen(uint32_t generation) {
+    connected_ = true;
+    linkGeneration_ = generation;
+}
+
+bool WiFiClient::halLinkLost() const {
+    return linkGeneration_ != halWifiLinkGeneration();
+}
+
+void WiFiClient::halSetResponse(const std::string& body, bool keepOpen) {
+    response_ = body;
+    position_ = 0;
+    if (connected_ && !keepOpen) {
+        halHttp().close(this);
+    }
+    connected_ = keepOpen;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Station mode of the WiFi driver, see native_hal.h. WiFi.begin() joins
+// after a short delay when halSetWifiAvailable() says the access point is
+// there, otherwise the attempt fails with "no AP found". Events are
+// delivered on their own thread, like the driver's event task does.
+
+typedef enum {
+    WIFI_MODE_NULL,
+    WIFI_MODE_STA,
+    WIFI_MODE_AP,
+    WIFI_MODE_APSTA,
+} wifi_mode_t;
+
+#define WIFI_OFF WIFI_MODE_NULL
+#define WIFI_STA WIFI_MODE_STA
+
+typedef enum {
+    WL_IDLE_STATUS = 0,
+    WL_NO_SSID_AVAIL = 1,
+    WL_CONNECTED = 3,
+    WL_CONNECT_FAILED = 4,
+    WL_CONNECTION_LOST = 5,
+    WL_DISCONNECTED = 6,
+} wl_status_t;
+
+typedef enum {
+    ARDUINO_EVENT_WIFI_READY = 0,
+    ARDUINO_EVENT_WIFI_SCAN_DONE,
+    ARDUINO_EVENT_WIFI_STA_START,
+    ARDUINO_EVENT_WIFI_STA_STOP,
+    ARDUINO_EVENT_WIFI_STA_CONNECTED,
+    ARDUINO_EVENT_WIFI_STA_DISCONNECTED,
+    ARDUINO_EVENT_WIFI_STA_AUTHMODE_CHANGE,
+    ARDUINO_EVENT_WIFI_STA_GOT_IP,
+    ARDUINO_EVENT_WIFI_STA_GOT_IP6,
+    ARDUINO_EVENT_WIFI_STA_LOST_IP,
+    ARDUINO_EVENT_MAX,
+} arduino_event_id_t;
+
+// Disconnect reasons the fake reports
+#define WIFI_REASON_ASSOC_LEAVE 8
+#define WIFI_REASON_BEACON_TIMEOUT 200
+#define WIFI_REASON_NO_AP_FOUND 201
+
+typedef struct {
+    uint8_t ssid[33];
+    uint8_t ssid_len;
+    uint8_t bssid[6];
+    uint8_t reason;
+} wifi_event_sta_disconnected_t;
+
+typedef union {
+    wifi_event_sta_disconnected_t wifi_sta_disconnected;
+} arduino_event_info_t;
+
+typedef void (*WiFiEventFuncCb)(arduino_event_id_t event, arduino_event_info_t info);
+typedef size_t wifi_event_id_t;
+
+class IPAddress {
+public:
+    IPAddress() : address_(0) {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+        : address_((uint32_t)a | (uint32_t)b << 8 | (uint32_t)c << 16 | (uint32_t)d << 24) {}
+
+    String toString() const;
+    operator uint32_t() const { return address_; }
+
+private:
+    uint32_t address_;
+};
+
+class WiFiClass {
+public:
+    bool mode(wifi_mode_t mode);
+    bool setAutoReconnect(bool autoReconnect);
+    wifi_event_id_t onEvent(WiFiEventFuncCb callback, arduino_event_id_t event = ARDUINO_EVENT_MAX);
+
+    wl_status_t begin(const char* ssid, const char* passphrase = nullptr);
+    bool disconnect(bool wifiOff = false, bool eraseAp = false);
+
+    bool isConnected();
+    wl_status_t status();
+    IPAddress localIP();
+};
+
+extern WiFiClass WiFi;
+
+// Plain TCP client. Over the fake, a request and its response are one call
+// to halHttp(); the client keeps the response body to be read back and
+// whether the connection is still open.
+class WiFiClient : public Stream {
+public:
+    virtual ~WiFiClient() {}
+
+    // True until the server, stop() or a lost link closed the connection.
+    // Like a real socket, a link lost in the meantime only shows up on the
+    // next request.
+    bool connected() const { return connected_; }
+    void stop();
+
+    int available() override { return (int)(response_.size() - position_); }
+    int read() override;
+    int peek() override;
+    size_t write(uint8_t c) override { (void)c; return 0; }
+    using Print::write;
+
+    // For HTTPClient
+    void halOpen(uint32_t linkGeneration);
+    bool halLinkLost() const;
+    void halSetResponse(const std::string& body, bool keepOpen);
+
+private:
+    bool connected_ = false;
+    uint32_t linkGeneration_ = 0;
+    std::string response_;
+    size_t position_ = 0;
+};
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <WiFi.h>
+
+// TLS is not simulated, certificates are accepted and ignored
+class WiFiClientSecure : public WiFiClient {
+public:
+    void setInsecure() {}
+    void setCACert(const char* rootCA) { (void)rootCA; }
+};
@@ -0,0 +1,20 @@
+#pragma once
+
+// Placeholder settings for [env:native]. An include/config.h with the real
+// ones takes precedence; natively they never leave the process anyway.
+
+#ifndef WIFI_NAME
+#define WIFI_NAME "native"
+#endif
+
+#ifndef WIFI_PASS
+#define WIFI_PASS "native"
+#endif
+
+#ifndef TELEGRAM_BOT_TOKEN
+#define TELEGRAM_BOT_TOKEN "123456:native"
+#endif
+
+#ifndef TELEGRAM_GRP_CHAT_ID
+#define TELEGRAM_GRP_CHAT_ID "-1001234567890"
+#endif
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <stdint.h>
+
+// RTC timer, on halClock(). A host process never sleeps, so it runs in step
+// with esp_timer.
+uint64_t esp_clk_rtc_time();
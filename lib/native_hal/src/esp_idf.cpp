@@ -0,0 +1,248 @@
+#include <string.h>
+#include <memory>
+#include <random>
+#include <vector>
+#include <Arduino.h>
+#include <WiFi.h>
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_rom_crc.h"
+#include "esp_sntp.h"
+#include "esp_partition.h"
+#include "esp32/clk.h"
+#include "native_hal.h"
+
+int64_t esp_timer_get_time() {
+    return halClock().nowMicros();
+}
+
+uint64_t esp_clk_rtc_time() {
+    return (uint64_t)halClock().nowMicros();
+}
+
+esp_reset_reason_t esp_reset_reason() {
+    return ESP_RST_POWERON;
+}
+
+static std::mutex randomLock;
+static std::mt19937 randomEngine(0x5EED);
+
+uint32_t esp_random() {
+    std::lock_guard<std::mutex> lock(randomLock);
+    return (uint32_t)randomEngine();
+}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t* buf, uint32_t len) {
+    crc = ~crc;
+    while (len--) {
+        crc ^= *buf++;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+// --- SNTP ---
+
+static std::mutex sntpLock;
+static std::condition_variable sntpWake;
+static bool sntpRunning = false;
+static sntp_sync_time_cb_t sntpCallback = nullptr;
+static uint32_t sntpInterval_ms = 3600000;
+static int64_t sntpNextSync_us = 0;
+
+// How often the client looks for a usable link while it has none
+static const int64_t sntpPollMicros = 100000;
+
+static void sntpTask() {
+    HalClock& clock = halClock();
+    std::unique_lock<std::mutex> lock(sntpLock);
+    for (;;) {
+        int64_t now = clock.nowMicros();
+        bool online = WiFi.isConnected();
+        if (online && now >= sntpNextSync_us) {
+            sntpNextSync_us = now + (int64_t)sntpInterval_ms * 1000;
+            sntp_sync_time_cb_t callback = sntpCallback;
+            lock.unlock();
+
+            int64_t epoch_us = halEpochMicros();
+            struct timeval tv;
+            tv.tv_sec = (time_t)(epoch_us / 1000000);
+            tv.tv_usec = (suseconds_t)(epoch_us % 1000000);
+            if (callback) {
+                callback(&tv);
+            }
+            lock.lock();
+            continue;
+        }
+        // Online it sleeps until the next sync is due, sntp_restart() wakes it
+        clock.waitMicros(lock, sntpWake, online ? sntpNextSync_us - now : sntpPollMicros);
+    }
+}
+
+void configTime(long gmtOffset_sec, int daylightOffset_sec, const char* server1, const char* server2, const char* server3) {
+    // Host time is UTC and there is no server, the fake SNTP hands out halEpochMicros()
+    (void)gmtOffset_sec;
+    (void)daylightOffset_sec;
+    (void)server1;
+    (void)server2;
+    (void)server3;
+    std::lock_guard<std::mutex> lock(sntpLock);
+    sntpNextSync_us = 0;
+    if (!sntpRunning) {
+        sntpRunning = true;
+        halClock().spawn(sntpTask);
+    }
+    halClock().notifyAll(sntpWake);
+}
+
+void sntp_set_time_sync_notification_cb(sntp_sync_time_cb_t callback) {
+    std::lock_guard<std::mutex> lock(sntpLock);
+    sntpCallback = callback;
+}
+
+void sntp_set_sync_interval(uint32_t interval_ms) {
+    std::lock_guard<std::mutex> lock(sntpLock);
+    sntpInterval_ms = interval_ms;
+}
+
+uint32_t sntp_get_sync_interval() {
+    std::lock_guard<std::mutex> lock(sntpLock);
+    return sntpInterval_ms;
+}
+
+bool sntp_restart() {
+    std::lock_guard<std::mutex> lock(sntpLock);
+    if (!sntpRunning) {
+        return false;
+    }
+    sntpNextSync_us = 0;
+    halClock().notifyAll(sntpWake);
+    return true;
+}
+
+bool sntp_enabled() {
+    std::lock_guard<std::mutex> lock(sntpLock);
+    return sntpRunning;
+}
+
+// --- Raw flash partitions ---
+
+struct HalPartition {
+    esp_partition_t info;
+    std::vector<uint8_t> data;
+};
+
+// Flash operations are serialized, as they are on the chip
+static std::mutex flashLock;
+static std::vector<std::unique_ptr<HalPartition>> partitions;
+static uint32_t nextAddress = 0x10000;
+static std::function<void(const HalFlashOperation&)> flashObserver;
+
+void halSetFlashObserver(std::function<void(const HalFlashOperation&)> observer) {
+    std::lock_guard<std::mutex> lock(flashLock);
+    flashObserver = observer;
+}
+
+// Call without flashLock held, the observer may read the partition
+static void reportFlash(std::function<void(const HalFlashOperation&)> observer, const esp_partition_t* partition,
+                        bool erase, size_t offset, size_t size) {
+    if (observer) {
+        HalFlashOperation operation = { halClock().nowMicros(), partition->label, erase, (uint32_t)offset, (uint32_t)size };
+        observer(operation);
+    }
+}
+
+void halAddPartition(const char* label, uint8_t type, uint8_t subtype, uint32_t size) {
+    std::lock_guard<std::mutex> lock(flashLock);
+    std::unique_ptr<HalPartition> partition(new HalPartition());
+    partition->info.type = (esp_partition_type_t)type;
+    partition->info.subtype = (esp_partition_subtype_t)subtype;
+    partition->info.address = nextAddress;
+    partition->info.size = size;
+    strncpy(partition->info.label, label, sizeof(partition->info.label) - 1);
+    partition->info.encrypted = false;
+    partition->data.assign(size, 0xFF);
+    nextAddress += size;
+    partitions.push_back(std::move(partition));
+}
+
+static HalPartition* findPartition(const esp_partition_t* info) {
+    for (auto& partition : partitions) {
+        if (&partition->info == info) {
+            return partition.get();
+        }
+    }
+    return nullptr;
+}
+
+const esp_partition_t* esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char* label) {
+    std::lock_guard<std::mutex> lock(flashLock);
+    for (auto& partition : partitions) {
+        const esp_partition_t& info = partition->info;
+        if (info.type == type
+                && (subtype == ESP_PARTITION_SUBTYPE_ANY || info.subtype == subtype)
+                && (!label || strcmp(info.label, label) == 0)) {
+            return &info;
+        }
+    }
+    return nullptr;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t* partition, size_t srcOffset, void* dst, size_t size) {
+    std::lock_guard<std::mutex> lock(flashLock);
+    HalPartition* flash = findPartition(partition);
+    if (!flash || !dst) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (srcOffset > flash->data.size() || size > flash->data.size() - srcOffset) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(dst, flash->data.data() + srcOffset, size);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t* partition, size_t dstOffset, const void* src, size_t size) {
+    std::function<void(const HalFlashOperation&)> observer;
+    {
+        std::lock_guard<std::mutex> lock(flashLock);
+        HalPartition* flash = findPartition(partition);
+        if (!flash || !src) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        if (dstOffset > flash->data.size() || size > flash->data.size() - dstOffset) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        // Programming only turns ones into zeros
+        const uint8_t* bytes = (const uint8_t*)src;
+        for (size_t i = 0; i < size; i++) {
+            flash->data[dstOffset + i] &= bytes[i];
+        }
+        observer = flashObserver;
+    }
+    reportFlash(observer, partition, false, dstOffset, size);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t* partition, size_t offset, size_t size) {
+    std::function<void(const HalFlashOperation&)> observer;
+    {
+        std::lock_guard<std::mutex> lock(flashLock);
+        HalPartition* flash = findPartition(partition);
+        if (!flash) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        if (offset % SPI_FLASH_SEC_SIZE != 0 || size % SPI_FLASH_SEC_SIZE != 0) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        if (offset > flash->data.size() || size > flash->data.size() - offset) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        memset(flash->data.data() + offset, 0xFF, size);
+        observer = flashObserver;
+    }
+    reportFlash(observer, partition, true, offset, size);
+    return ESP_OK;
+}
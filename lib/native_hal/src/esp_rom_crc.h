@@ -0,0 +1,7 @@
+#pragma once
+
+#include <stdint.h>
+
+// Same results as the ROM function: CRC-32 (IEEE), crc is the value of the
+// data so far, 0 to start
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t* buf, uint32_t len);
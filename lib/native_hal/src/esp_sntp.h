@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdint.h>
+#include <sys/time.h>
+
+// SNTP client. Once configTime() has started it, it "syncs" whenever WiFi is
+// up and a sync is due, and reports halEpochMicros() as the time.
+
+typedef void (*sntp_sync_time_cb_t)(struct timeval* tv);
+
+void sntp_set_time_sync_notification_cb(sntp_sync_time_cb_t callback);
+void sntp_set_sync_interval(uint32_t interval_ms);
+uint32_t sntp_get_sync_interval();
+bool sntp_restart();
+bool sntp_enabled();
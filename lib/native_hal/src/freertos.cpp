@@ -0,0 +1,169 @@
+#include <string.h>
+#include <deque>
+#include <string>
+#include <vector>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "native_hal.h"
+
+struct HalTask {
+    std::string name;
+};
+
+struct HalQueue {
+    std::mutex lock;
+    std::condition_variable changed;
+    std::deque<std::vector<uint8_t>> items;
+    size_t length;
+    size_t itemSize;
+};
+
+struct HalSemaphore {
+    std::mutex lock;
+    std::condition_variable released;
+    bool taken = false;
+};
+
+static std::recursive_mutex criticalLock;
+
+static HalTask loopTask = { "loopTask" };
+static thread_local HalTask* currentTask = &loopTask;
+
+void vPortEnterCritical(portMUX_TYPE* mux) {
+    (void)mux;
+    criticalLock.lock();
+}
+
+void vPortExitCritical(portMUX_TYPE* mux) {
+    (void)mux;
+    criticalLock.unlock();
+}
+
+// Waits on cv until ready() holds or ticks have passed on halClock()
+template <typename TReady>
+static bool waitTicks(std::unique_lock<std::mutex>& lock, std::condition_variable& cv, TickType_t ticks, TReady ready) {
+    HalClock& clock = halClock();
+    const int64_t deadline = clock.nowMicros() + (int64_t)ticks * 1000;
+    while (!ready()) {
+        if (ticks == portMAX_DELAY) {
+            clock.waitMicros(lock, cv, -1);
+            continue;
+        }
+        int64_t remaining = deadline - clock.nowMicros();
+        if (remaining <= 0) {
+            return false;
+        }
+        clock.waitMicros(lock, cv, remaining);
+    }
+    return true;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t code, const char* name, uint32_t stackDepth, void* parameter,
+                                   UBaseType_t priority, TaskHandle_t* createdTask, BaseType_t coreId) {
+    // Every task is a host thread, stack size, priority and core don't apply
+    (void)stackDepth;
+    (void)priority;
+    (void)coreId;
+    HalTask* task = new HalTask();
+    task->name = name;
+    if (createdTask) {
+        *createdTask = task;
+    }
+    halClock().spawn([code, parameter, task]() {
+        currentTask = task;
+        code(parameter);
+    });
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t code, const char* name, uint32_t stackDepth, void* parameter,
+                       UBaseType_t priority, TaskHandle_t* createdTask) {
+    return xTaskCreatePinnedToCore(code, name, stackDepth, parameter, priority, createdTask, tskNO_AFFINITY);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    return currentTask;
+}
+
+const char* pcTaskGetName(TaskHandle_t task) {
+    return (task ? task : currentTask)->name.c_str();
+}
+
+void vTaskDelay(TickType_t ticks) {
+    halClock().sleepMicros((int64_t)ticks * 1000);
+}
+
+TickType_t xTaskGetTickCount() {
+    return (TickType_t)(halClock().nowMicros() / 1000);
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+    HalQueue* queue = new HalQueue();
+    queue->length = length;
+    queue->itemSize = itemSize;
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+    delete queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticksToWait) {
+    std::unique_lock<std::mutex> lock(queue->lock);
+    if (!waitTicks(lock, queue->changed, ticksToWait, [queue]() { return queue->items.size() < queue->length; })) {
+        return pdFALSE;
+    }
+    const uint8_t* bytes = (const uint8_t*)item;
+    queue->items.emplace_back(bytes, bytes + queue->itemSize);
+    halClock().notifyAll(queue->changed);
+    return pdTRUE;
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void* item, TickType_t ticksToWait) {
+    return xQueueSend(queue, item, ticksToWait);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* buffer, TickType_t ticksToWait) {
+    std::unique_lock<std::mutex> lock(queue->lock);
+    if (!waitTicks(lock, queue->changed, ticksToWait, [queue]() { return !queue->items.empty(); })) {
+        return pdFALSE;
+    }
+    memcpy(buffer, queue->items.front().data(), queue->itemSize);
+    queue->items.pop_front();
+    halClock().notifyAll(queue->changed);
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    std::lock_guard<std::mutex> lock(queue->lock);
+    return (UBaseType_t)queue->items.size();
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+    return new HalSemaphore();
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore) {
+    delete semaphore;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticksToWait) {
+    std::unique_lock<std::mutex> lock(semaphore->lock);
+    if (!waitTicks(lock, semaphore->released, ticksToWait, [semaphore]() { return !semaphore->taken; })) {
+        return pdFALSE;
+    }
+    semaphore->taken = true;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    std::lock_guard<std::mutex> lock(semaphore->lock);
+    if (!semaphore->taken) {
+        return pdFALSE;
+    }
+    semaphore->taken = false;
+    halClock().notifyAll(semaphore->released);
+    return pdTRUE;
+}
@@ -0,0 +1,330 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <HTTPClient.h>
+#include "native_hal.h"
+
+// --- clock ---
+
+static int64_t steadyMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+SystemClock::SystemClock() : start_(steadyMicros()) {
+}
+
+int64_t SystemClock::nowMicros() {
+    return steadyMicros() - start_;
+}
+
+void SystemClock::sleepMicros(int64_t us) {
+    if (us > 0) {
+        std::this_thread::sleep_for(std::chrono::microseconds(us));
+    } else {
+        std::this_thread::yield();
+    }
+}
+
+void SystemClock::waitMicros(std::unique_lock<std::mutex>& lock, std::condition_variable& cv, int64_t us) {
+    if (us < 0) {
+        cv.wait(lock);
+    } else {
+        cv.wait_for(lock, std::chrono::microseconds(us));
+    }
+}
+
+void SystemClock::notifyAll(std::condition_variable& cv) {
+    cv.notify_all();
+}
+
+void SystemClock::spawn(std::function<void()> body) {
+    std::thread(body).detach();
+}
+
+static SystemClock systemClock;
+static HalClock* currentClock = &systemClock;
+
+static int64_t bootEpoch_us = std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::system_clock::now().time_since_epoch()).count();
+
+HalClock& halClock() {
+    return *currentClock;
+}
+
+void halSetClock(HalClock* newClock) {
+    currentClock = newClock ? newClock : &systemClock;
+}
+
+void halSetBootEpoch(int64_t epoch_us) {
+    bootEpoch_us = epoch_us;
+}
+
+int64_t halEpochMicros() {
+    return bootEpoch_us + currentClock->nowMicros();
+}
+
+// --- filesystem ---
+
+static std::string filesystemRoot = ".";
+
+void halSetFilesystemRoot(const char* path) {
+    filesystemRoot = path;
+}
+
+std::string halFilesystemPath(const char* path) {
+    return filesystemRoot + (path[0] == '/' ? "" : "/") + path;
+}
+
+// --- http ---
+
+static FakeTelegramApi telegramApi;
+static SocketHttp socketHttp;
+
+// Plain http:// requests, e.g. to the stand-in server, go out over the
+// network; https ones, the real api.telegram.org, get the fake
+class DefaultHttp : public HalHttp {
+public:
+    int request(const HalHttpRequest& request, HalHttpResponse& response) override {
+        return request.https ? telegramApi.request(request, response) : socketHttp.request(request, response);
+    }
+
+    void close(const void* connection) override {
+        socketHttp.close(connection);
+    }
+};
+
+static DefaultHttp defaultHttp;
+static HalHttp* currentHttp = &defaultHttp;
+
+HalHttp& halHttp() {
+    return *currentHttp;
+}
+
+void halSetHttp(HalHttp* newHttp) {
+    currentHttp = newHttp ? newHttp : &defaultHttp;
+}
+
+// Value of name in a query string or form body, url-decoded
+static std::string formValue(const std::string& form, const char* name) {
+    std::string key = std::string(name) + "=";
+    size_t start = 0;
+    while (start < form.size()) {
+        size_t end = form.find('&', start);
+        if (end == std::string::npos) {
+            end = form.size();
+        }
+        if (form.compare(start, key.size(), key) == 0) {
+            std::string value;
+            for (size_t i = start + key.size(); i < end; i++) {
+                if (form[i] == '%' && i + 2 < end) {
+                    value += (char)strtol(form.substr(i + 1, 2).c_str(), nullptr, 16);
+                    i += 2;
+                } else {
+                    value += form[i] == '+' ? ' ' : form[i];
+                }
+            }
+            return value;
+        }
+        start = end + 1;
+    }
+    return std::string();
+}
+
+static std::string jsonString(const std::string& text) {
+    std::string quoted = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+            quoted += c;
+        } else if ((uint8_t)c < 0x20) {
+            char escape[8];
+            snprintf(escape, sizeof(escape), "\\u%04x", (unsigned)(uint8_t)c);
+            quoted += escape;
+        } else {
+            quoted += c;
+        }
+    }
+    return quoted + "\"";
+}
+
+static std::string errorBody(int code, const char* description) {
+    char body[128];
+    snprintf(body, sizeof(body), "{\"ok\":false,\"error_code\":%d,\"description\":\"%s\"}", code, description);
+    return body;
+}
+
+static std::string throttleBody(uint32_t retryAfter_s) {
+    char body[160];
+    snprintf(body, sizeof(body),
+             "{\"ok\":false,\"error_code\":429,\"description\":\"Too Many Requests: retry after %u\","
+             "\"parameters\":{\"retry_after\":%u}}", (unsigned)retryAfter_s, (unsigned)retryAfter_s);
+    return body;
+}
+
+void FakeTelegramApi::setFaults(const HalApiFaults& faults, uint32_t seed) {
+    std::lock_guard<std::mutex> lock(lock_);
+    faults_ = faults;
+    random_ = seed;
+}
+
+void FakeTelegramApi::postUpdate(const std::string& text, bool isReply) {
+    std::lock_guard<std::mutex> lock(lock_);
+    Update update = { nextUpdateId_++, halEpochMicros() / 1000000, text, isReply };
+    updates_.push_back(update);
+    halClock().notifyAll(updatePosted_);
+}
+
+int FakeTelegramApi::request(const HalHttpRequest& request, HalHttpResponse& response) {
+    if (latency_us_ > 0) {
+        halClock().sleepMicros(latency_us_);
+    }
+    size_t queryStart = request.path.find('?');
+    std::string path = request.path.substr(0, queryStart);
+    std::string query = queryStart == std::string::npos ? std::string() : request.path.substr(queryStart + 1);
+    std::string method = path.substr(path.rfind('/') + 1);
+
+    // One draw per request picks its fault, if any
+    bool truncate;
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        stats_.requests++;
+        random_ = random_ * 1103515245 + 12345;
+        uint32_t draw = (random_ >> 8) % 1000;
+        if (draw < faults_.reset) {
+            stats_.resets++;
+            return HTTPC_ERROR_CONNECTION_LOST;
+        }
+        draw -= faults_.reset;
+        if (draw < faults_.throttle) {
+            stats_.throttled++;
+            response.body = throttleBody(faults_.retryAfter_s);
+            return 429;
+        }
+        draw -= faults_.throttle;
+        if (draw < faults_.serverError) {
+            stats_.serverErrors++;
+            response.body = errorBody(502, "Bad Gateway");
+            return 502;
+        }
+        draw -= faults_.serverError;
+        truncate = draw < faults_.truncate;
+    }
+
+    int code;
+    if (method == "sendMessage") {
+        code = sendMessage(request, response);
+    } else if (method == "getUpdates") {
+        code = getUpdates(query, response);
+    } else {
+        response.body = errorBody(404, "Not Found");
+        code = 404;
+    }
+
+    if (truncate) {
+        std::lock_guard<std::mutex> lock(lock_);
+        stats_.truncated++;
+        size_t keep = response.body.size() / 2;
+        response.missing = response.body.size() - keep;
+        response.body.resize(keep);
+        response.keepAlive = false;
+    }
+    return code;
+}
+
+int FakeTelegramApi::sendMessage(const HalHttpRequest& request, HalHttpResponse& response) {
+    HalSentMessage message = { halClock().nowMicros(), formValue(request.body, "text") };
+    uint32_t id;
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        if (faults_.groupPerMinute > 0) {
+            // Sliding minute, the oldest send leaving it makes room for the next
+            const int64_t minute = 60000000;
+            recentSends_.erase(recentSends_.begin(), std::upper_bound(recentSends_.begin(), recentSends_.end(),
+                                                                      message.time_us - minute));
+            if (recentSends_.size() >= faults_.groupPerMinute) {
+                int64_t wait_us = recentSends_.front() + minute - message.time_us;
+                stats_.throttled++;
+                response.body = throttleBody((uint32_t)std::max<int64_t>(1, (wait_us + 999999) / 1000000));
+                return 429;
+            }
+            recentSends_.push_back(message.time_us);
+        }
+        sent_.push_back(message);
+        stats_.messages++;
+        id = (uint32_t)sent_.size();
+    }
+    if (observer_) {
+        observer_(message);
+    }
+    if (echo_) {
+        printf("[telegram] %s\n", message.text.c_str());
+    }
+    char body[64];
+    snprintf(body, sizeof(body), "{\"ok\":true,\"result\":{\"message_id\":%u}}", (unsigned)id);
+    response.body = body;
+    return 200;
+}
+
+int FakeTelegramApi::getUpdates(const std::string& query, HalHttpResponse& response) {
+    const int32_t offset = atoi(formValue(query, "offset").c_str());
+    const int timeout_s = atoi(formValue(query, "timeout").c_str());
+    HalClock& clock = halClock();
+    const int64_t deadline = clock.nowMicros() + (int64_t)timeout_s * 1000000;
+
+    std::unique_lock<std::mutex> lock(lock_);
+    stats_.polls++;
+    // An offset confirms every update before it, a negative one keeps only
+    // the last -offset of them
+    if (offset > 0) {
+        while (!updates_.empty() && updates_.front().id < offset) {
+            updates_.erase(updates_.begin());
+        }
+    } else if (offset < 0 && updates_.size() > (size_t)-offset) {
+        updates_.erase(updates_.begin(), updates_.end() + offset);
+    }
+    // Long poll, answered as soon as something arrives
+    while (updates_.empty()) {
+        int64_t remaining = deadline - clock.nowMicros();
+        if (remaining <= 0) {
+            break;
+        }
+        clock.waitMicros(lock, updatePosted_, remaining);
+    }
+
+    std::string body = "{\"ok\":true,\"result\":[";
+    for (size_t i = 0; i < updates_.size(); i++) {
+        const Update& update = updates_[i];
+        char head[192];
+        snprintf(head, sizeof(head),
+                 "%s{\"update_id\":%d,\"message\":{\"message_id\":%d,\"date\":%lld,"
+                 "\"chat\":{\"id\":-1001234567890,\"type\":\"supergroup\"},",
+                 i > 0 ? "," : "", (int)update.id, (int)(update.id + 1000), (long long)update.epoch_s);
+        body += head;
+        if (update.isReply) {
+            body += "\"reply_to_message\":{\"message_id\":1},";
+        }
+        body += "\"text\":" + jsonString(update.text) + "}}";
+    }
+    body += "]}";
+    stats_.updates += (uint32_t)updates_.size();
+    response.body = body;
+    return 200;
+}
+
+uint32_t FakeTelegramApi::messages() {
+    std::lock_guard<std::mutex> lock(lock_);
+    return (uint32_t)sent_.size();
+}
+
+std::vector<HalSentMessage> FakeTelegramApi::sent() {
+    std::lock_guard<std::mutex> lock(lock_);
+    return sent_;
+}
+
+HalApiStats FakeTelegramApi::stats() {
+    std::lock_guard<std::mutex> lock(lock_);
+    return stats_;
+}
@@ -0,0 +1,266 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Host side of [env:native].
+//
+// The firmware only reaches the hardware through the Arduino-ESP32 and
+// ESP-IDF APIs: digitalRead() and attachInterrupt(), millis() and
+// esp_timer, FS and raw flash partitions, HTTPClient, WiFi. On the board
+// those are the framework. This library implements the same headers on
+// Linux, so the unchanged firmware sources build and run as a normal
+// process that perf, gprof, valgrind or the sanitizers can look at.
+//
+// Every API call ends up in one of five areas, and this header is how a
+// host program drives them:
+//
+//   clock       HalClock, replaceable. Behind millis(), micros(),
+//               esp_timer_get_time(), delay(), vTaskDelay() and every
+//               FreeRTOS timeout; it also starts the threads.
+//               VirtualClock (virtual_clock.h) runs simulations.
+//   gpio        Pin levels the firmware reads; driving a pin runs its
+//               interrupt handler like a real edge would.
+//   filesystem  FS paths map into a host directory; raw flash partitions
+//               and NVS are kept in memory, with NOR flash write rules.
+//   http        HalHttp, replaceable. Every HTTPClient request goes to it;
+//               by default FakeTelegramApi answers https requests and
+//               SocketHttp sends plain http ones out over the network.
+//   wifi        Whether WiFi.begin() finds the access point. Events arrive
+//               on their own thread as they do from the driver.
+//
+// FreeRTOS tasks are threads, queues and mutexes are built on std::mutex,
+// and a critical section is one process-wide lock that interrupt handlers
+// run under as well.
+
+// Where Serial output goes, stdout by default, nullptr drops it
+void halSetSerialOutput(FILE* out);
+
+// --- clock ---
+
+class HalClock {
+public:
+    virtual ~HalClock() {}
+
+    // Monotonic time since boot
+    virtual int64_t nowMicros() = 0;
+
+    // Blocks the calling task for us of this clock's time
+    virtual void sleepMicros(int64_t us) = 0;
+
+    // Waits on cv, with lock held, until notified or us have passed, for
+    // good when us < 0. May return early, callers check their condition
+    // again.
+    virtual void waitMicros(std::unique_lock<std::mutex>& lock, std::condition_variable& cv, int64_t us) = 0;
+
+    // Wakes everything waiting on cv. Code that waits through the clock must
+    // also notify through it.
+    virtual void notifyAll(std::condition_variable& cv) = 0;
+
+    // Runs body on a new thread. Every thread the host side starts, tasks
+    // included, is started this way.
+    virtual void spawn(std::function<void()> body) = 0;
+};
+
+// Host steady clock, the default
+class SystemClock : public HalClock {
+public:
+    SystemClock();
+    int64_t nowMicros() override;
+    void sleepMicros(int64_t us) override;
+    void waitMicros(std::unique_lock<std::mutex>& lock, std::condition_variable& cv, int64_t us) override;
+    void notifyAll(std::condition_variable& cv) override;
+    void spawn(std::function<void()> body) override;
+
+private:
+    int64_t start_;     // host steady clock at boot, in us
+};
+
+HalClock& halClock();
+// Set before setup(), the clock must outlive the process
+void halSetClock(HalClock* clock);
+
+// Wall-clock time at boot. SNTP hands out this plus halClock() time.
+// Defaults to the host's time when the process started.
+void halSetBootEpoch(int64_t epoch_us);
+int64_t halEpochMicros();
+
+// --- gpio ---
+
+// Drives an input pin. A change runs the handler attachInterrupt()
+// registered for the pin, on the calling thread, inside the critical
+// section like an interrupt on the board.
+void halWritePin(uint8_t pin, int level);
+int halReadPin(uint8_t pin);
+
+// --- filesystem ---
+
+// Directory FS and SPIFFS paths are relative to, the working directory by default
+void halSetFilesystemRoot(const char* path);
+std::string halFilesystemPath(const char* path);
+
+// Adds an erased raw flash partition for esp_partition_find_first(),
+// e.g. the ones partitions.csv declares
+void halAddPartition(const char* label, uint8_t type, uint8_t subtype, uint32_t size);
+
+struct HalFlashOperation {
+    int64_t time_us;
+    const char* label;          // partition
+    bool erase;                 // else a write
+    uint32_t offset;
+    uint32_t size;
+};
+
+// Called after every partition write and erase that succeeded, on the
+// thread that made it
+void halSetFlashObserver(std::function<void(const HalFlashOperation&)> observer);
+
+// --- http ---
+
+struct HalHttpRequest {
+    std::string method;
+    std::string host;
+    uint16_t port;
+    bool https;
+    std::string path;           // with the query string
+    std::map<std::string, std::string> headers;
+    std::string body;
+    uint32_t timeoutMs;
+    const void* connection;     // the WiFiClient it goes over
+    bool reused;                // that client's connection is still open from the last request
+};
+
+struct HalHttpResponse {
+    std::string body;
+    bool chunked = false;       // body is in chunked transfer encoding, no Content-Length
+    bool keepAlive = true;      // the connection stays open for the next request
+    size_t missing = 0;         // Content-Length promised this many bytes more, then the connection closed
+};
+
+class HalHttp {
+public:
+    virtual ~HalHttp() {}
+
+    // Carries out one request. Returns the HTTP status code, or a negative
+    // HTTPC_ERROR_* code when the request never got an answer.
+    virtual int request(const HalHttpRequest& request, HalHttpResponse& response) = 0;
+
+    // The client closed its connection, from WiFiClient::stop()
+    virtual void close(const void* connection) { (void)connection; }
+};
+
+// Plain HTTP/1.1 over the host's sockets, e.g. to the stand-in server of
+// src/standin. Every WiFiClient gets its own socket, kept open as long as
+// the server allows. https requests are refused, TLS is not simulated.
+class SocketHttp : public HalHttp {
+public:
+    int request(const HalHttpRequest& request, HalHttpResponse& response) override;
+    void close(const void* connection) override;
+
+private:
+    int connect(const HalHttpRequest& request);
+
+    std::mutex lock_;
+    std::map<const void*, int> sockets_;
+};
+
+struct HalSentMessage {
+    int64_t time_us;            // halClock() time the server took it
+    std::string text;
+};
+
+// Failures FakeTelegramApi mixes into its answers, each in requests per
+// thousand. A request draws at most one of them.
+struct HalApiFaults {
+    uint16_t reset = 0;             // connection reset, the request is lost
+    uint16_t throttle = 0;          // 429 with retryAfter_s
+    uint16_t serverError = 0;       // 502 Bad Gateway
+    uint16_t truncate = 0;          // handled, but the body breaks off halfway and the connection closes
+    uint32_t retryAfter_s = 5;
+    // sendMessage calls a minute before the group is throttled, the way
+    // Telegram allows about 20 into a group. 0 = no limit.
+    uint32_t groupPerMinute = 0;
+};
+
+struct HalApiStats {
+    uint32_t requests;
+    uint32_t messages;              // sendMessage calls answered 200
+    uint32_t polls;                 // getUpdates calls
+    uint32_t updates;               // handed out by getUpdates
+    uint32_t resets;
+    uint32_t throttled;             // 429s, group limit included
+    uint32_t serverErrors;
+    uint32_t truncated;
+};
+
+// Stands in for the Telegram Bot API. sendMessage keeps the text and
+// answers like Telegram; getUpdates hands out what postUpdate() queued,
+// long-polling on halClock() for its timeout when there is nothing.
+class FakeTelegramApi : public HalHttp {
+public:
+    int request(const HalHttpRequest& request, HalHttpResponse& response) override;
+
+    // Every request takes this long on halClock() before it is answered
+    void setLatency(int64_t us) { latency_us_ = us; }
+    // Print every text sent to stdout, on by default
+    void setEcho(bool echo) { echo_ = echo; }
+    // Set before the first request. The draws come from their own generator,
+    // the same seed gives the same faults for the same requests.
+    void setFaults(const HalApiFaults& faults, uint32_t seed = 1);
+    // Called for every accepted sendMessage, on the requesting thread
+    void onMessage(std::function<void(const HalSentMessage&)> observer) { observer_ = observer; }
+
+    // A message in the group for getUpdates, isReply = sent as a reply to one of the bot's
+    void postUpdate(const std::string& text, bool isReply);
+
+    uint32_t messages();
+    std::vector<HalSentMessage> sent();
+    HalApiStats stats();
+
+private:
+    struct Update {
+        int32_t id;
+        int64_t epoch_s;
+        std::string text;
+        bool isReply;
+    };
+
+    int fault(const std::string& method, HalHttpResponse& response);
+    int sendMessage(const HalHttpRequest& request, HalHttpResponse& response);
+    int getUpdates(const std::string& query, HalHttpResponse& response);
+
+    std::mutex lock_;
+    std::condition_variable updatePosted_;
+    std::vector<HalSentMessage> sent_;
+    std::vector<Update> updates_;
+    int32_t nextUpdateId_ = 1;
+    std::vector<int64_t> recentSends_;      // halClock() times of the last minute's accepted sends
+    HalApiFaults faults_;
+    uint32_t random_ = 1;
+    HalApiStats stats_ = {};
+    std::function<void(const HalSentMessage&)> observer_;
+    int64_t latency_us_ = 0;
+    bool echo_ = true;
+};
+
+HalHttp& halHttp();
+// Set before setup(), the backend must outlive the process. nullptr
+// restores the default.
+void halSetHttp(HalHttp* http);
+
+// --- wifi ---
+
+// Whether the access point is in range, true by default. Taking it away
+// drops a connected station with a beacon timeout.
+void halSetWifiAvailable(bool available);
+
+// Goes up by one every time the station loses its link, open sockets from
+// before are dead
+uint32_t halWifiLinkGeneration();
@@ -0,0 +1,62 @@
+// Entry point of [env:native]: sets up the host side, then runs setup() and
+// loop() the way the Arduino core's loopTask does.
+//
+//   pio run -e native -t exec                 runs for 60 s
+//   .pio/build/native/program 10 2000         10 s, the shutter flips every 2 s
+//
+// Arguments: seconds to run (0 = until killed), and how often the first
+// sensor in sensorTable changes state, in ms (0 = never).
+//
+// Host programs with a main() of their own, like the sensor simulator, build
+// with NATIVE_HAL_MAIN=0, and so do the unit tests under test/.
+
+#ifndef NATIVE_HAL_MAIN
+#ifdef PIO_UNIT_TESTING
+#define NATIVE_HAL_MAIN 0
+#else
+#define NATIVE_HAL_MAIN 1
+#endif
+#endif
+
+#if NATIVE_HAL_MAIN
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <Arduino.h>
+#include "esp_partition.h"
+#include "native_hal.h"
+#include "sensors.h"
+
+static void flipFirstSensor(uint32_t interval_ms) {
+    const uint8_t pin = sensorTable[0].pin;
+    for (;;) {
+        halClock().sleepMicros((int64_t)interval_ms * 1000);
+        halWritePin(pin, !halReadPin(pin));
+    }
+}
+
+int main(int argc, char** argv) {
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+    const double seconds = argc > 1 ? atof(argv[1]) : 60;
+    const uint32_t flip_ms = argc > 2 ? (uint32_t)atol(argv[2]) : 0;
+
+    // As in partitions.csv
+    halAddPartition("evlog", ESP_PARTITION_TYPE_DATA, 0x40, 0x20000);
+
+    setup();
+    if (flip_ms > 0) {
+        halClock().spawn([flip_ms]() { flipFirstSensor(flip_ms); });
+    }
+
+    const int64_t end_us = (int64_t)(seconds * 1000000);
+    while (seconds <= 0 || halClock().nowMicros() < end_us) {
+        loop();
+    }
+
+    // The firmware's tasks never return, leave without running destructors under them
+    fflush(stdout);
+    _exit(0);
+}
+
+#endif  // NATIVE_HAL_MAIN
@@ -0,0 +1,233 @@
+#include <errno.h>
+#include <netdb.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <HTTPClient.h>
+#include "native_hal.h"
+
+// What reading a response can end in, besides a complete one
+enum ReadResult {
+    READ_OK,
+    READ_CLOSED,        // the server closed before the response was complete
+    READ_TIMEOUT,
+};
+
+static void setTimeouts(int fd, uint32_t timeoutMs) {
+    struct timeval tv;
+    tv.tv_sec = timeoutMs / 1000;
+    tv.tv_usec = (timeoutMs % 1000) * 1000;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+static bool sendAll(int fd, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return false;
+        }
+        sent += n;
+    }
+    return true;
+}
+
+// Buffered reads off one socket
+struct SocketReader {
+    int fd;
+    std::string buffer;
+    ReadResult error;
+
+    bool fill() {
+        char chunk[4096];
+        ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+        if (n > 0) {
+            buffer.append(chunk, n);
+            return true;
+        }
+        error = n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) ? READ_TIMEOUT : READ_CLOSED;
+        return false;
+    }
+
+    // Up to and without the CRLF
+    bool line(std::string& out) {
+        size_t end;
+        while ((end = buffer.find("\r\n")) == std::string::npos) {
+            if (!fill()) {
+                return false;
+            }
+        }
+        out = buffer.substr(0, end);
+        buffer.erase(0, end + 2);
+        return true;
+    }
+
+    // As many of size bytes as arrive
+    bool take(size_t size, std::string& out) {
+        while (buffer.size() < size) {
+            if (!fill()) {
+                out += buffer;
+                buffer.clear();
+                return false;
+            }
+        }
+        out += buffer.substr(0, size);
+        buffer.erase(0, size);
+        return true;
+    }
+};
+
+int SocketHttp::connect(const HalHttpRequest& request) {
+    struct addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* addresses = nullptr;
+    std::string port = std::to_string(request.port);
+    if (getaddrinfo(request.host.c_str(), port.c_str(), &hints, &addresses) != 0) {
+        return -1;
+    }
+    int fd = -1;
+    for (struct addrinfo* address = addresses; address; address = address->ai_next) {
+        fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        setTimeouts(fd, request.timeoutMs);
+        if (::connect(fd, address->ai_addr, address->ai_addrlen) == 0) {
+            break;
+        }
+        ::close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(addresses);
+    if (fd >= 0) {
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    }
+    return fd;
+}
+
+int SocketHttp::request(const HalHttpRequest& request, HalHttpResponse& response) {
+    if (request.https) {
+        return HTTPC_ERROR_CONNECTION_REFUSED;
+    }
+
+    // The socket belongs to the client until it is put back below, clients
+    // are used by one task at a time
+    int fd = -1;
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        auto found = sockets_.find(request.connection);
+        if (found != sockets_.end()) {
+            fd = found->second;
+            sockets_.erase(found);
+        }
+    }
+    if (fd >= 0 && !request.reused) {
+        ::close(fd);
+        fd = -1;
+    }
+    if (fd < 0) {
+        fd = connect(request);
+        if (fd < 0) {
+            return HTTPC_ERROR_CONNECTION_REFUSED;
+        }
+    }
+    setTimeouts(fd, request.timeoutMs);
+
+    std::string head = request.method + " " + request.path + " HTTP/1.1\r\nHost: " + request.host + "\r\n";
+    for (const auto& header : request.headers) {
+        head += header.first + ": " + header.second + "\r\n";
+    }
+    if (!request.body.empty() || request.method == "POST") {
+        head += "Content-Length: " + std::to_string(request.body.size()) + "\r\n";
+    }
+    head += "\r\n";
+    if (!sendAll(fd, head + request.body)) {
+        ::close(fd);
+        return HTTPC_ERROR_SEND_HEADER_FAILED;
+    }
+
+    SocketReader reader = { fd, std::string(), READ_OK };
+    std::string line;
+    int code = 0;
+    if (!reader.line(line) || sscanf(line.c_str(), "HTTP/%*d.%*d %d", &code) != 1) {
+        ::close(fd);
+        return reader.error == READ_TIMEOUT ? HTTPC_ERROR_READ_TIMEOUT : HTTPC_ERROR_CONNECTION_LOST;
+    }
+
+    long contentLength = -1;
+    bool keepAlive = true;
+    while (reader.line(line) && !line.empty()) {
+        size_t colon = line.find(':');
+        if (colon == std::string::npos) {
+            continue;
+        }
+        std::string name = line.substr(0, colon);
+        std::string value = line.substr(line.find_first_not_of(' ', colon + 1));
+        if (strcasecmp(name.c_str(), "Content-Length") == 0) {
+            contentLength = atol(value.c_str());
+        } else if (strcasecmp(name.c_str(), "Transfer-Encoding") == 0) {
+            response.chunked = strcasecmp(value.c_str(), "chunked") == 0;
+        } else if (strcasecmp(name.c_str(), "Connection") == 0) {
+            keepAlive = strcasecmp(value.c_str(), "close") != 0;
+        }
+    }
+    if (reader.error != READ_OK) {
+        ::close(fd);
+        return reader.error == READ_TIMEOUT ? HTTPC_ERROR_READ_TIMEOUT : HTTPC_ERROR_CONNECTION_LOST;
+    }
+
+    bool complete;
+    if (response.chunked) {
+        // Handed on still chunked, the firmware decodes it. Only the framing
+        // is followed here, to find the end.
+        complete = false;
+        while (reader.line(line)) {
+            response.body += line + "\r\n";
+            long size = strtol(line.c_str(), nullptr, 16);
+            if (!reader.take(size + 2, response.body)) {
+                break;
+            }
+            if (size == 0) {
+                complete = true;
+                break;
+            }
+        }
+    } else if (contentLength >= 0) {
+        complete = reader.take(contentLength, response.body);
+        if (!complete) {
+            response.missing = contentLength - response.body.size();
+        }
+    } else {
+        // Delimited by the end of the connection
+        while (reader.fill()) {
+        }
+        response.body = reader.buffer;
+        complete = reader.error == READ_CLOSED;
+        keepAlive = false;
+    }
+
+    response.keepAlive = keepAlive && complete;
+    if (response.keepAlive) {
+        std::lock_guard<std::mutex> lock(lock_);
+        sockets_[request.connection] = fd;
+    } else {
+        ::close(fd);
+    }
+    return code;
+}
+
+void SocketHttp::close(const void* connection) {
+    std::lock_guard<std::mutex> lock(lock_);
+    auto found = sockets_.find(connection);
+    if (found != sockets_.end()) {
+        ::close(found->second);
+        sockets_.erase(found);
+    }
+}
@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <thread>
+#include "virtual_clock.h"
+
+// Task of the calling thread, -1 for threads the clock did not start
+static thread_local int currentTask = -1;
+
+VirtualClock::VirtualClock() {
+    turns_.emplace_back(new std::condition_variable());
+    currentTask = 0;
+}
+
+int64_t VirtualClock::nowMicros() {
+    std::lock_guard<std::mutex> guard(lock_);
+    return now_;
+}
+
+void VirtualClock::sleepMicros(int64_t us) {
+    std::unique_lock<std::mutex> guard(lock_);
+    park(guard, now_ + (us > 0 ? us : 0), nullptr);
+}
+
+void VirtualClock::waitMicros(std::unique_lock<std::mutex>& lock, std::condition_variable& cv, int64_t us) {
+    // Nothing else runs until this task parks, so no notification can slip
+    // in between
+    lock.unlock();
+    {
+        std::unique_lock<std::mutex> guard(lock_);
+        park(guard, us < 0 ? INT64_MAX : now_ + us, &cv);
+    }
+    lock.lock();
+}
+
+void VirtualClock::notifyAll(std::condition_variable& cv) {
+    std::lock_guard<std::mutex> guard(lock_);
+    for (size_t i = 0; i < waiting_.size();) {
+        if (waiting_[i].channel == &cv) {
+            ready_.push_back(waiting_[i].task);
+            waiting_.erase(waiting_.begin() + i);
+        } else {
+            i++;
+        }
+    }
+}
+
+void VirtualClock::spawn(std::function<void()> body) {
+    int task;
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        task = (int)turns_.size();
+        turns_.emplace_back(new std::condition_variable());
+        ready_.push_back(task);
+    }
+    std::thread([this, task, body]() {
+        currentTask = task;
+        {
+            std::unique_lock<std::mutex> guard(lock_);
+            waitTurn(guard, task);
+        }
+        body();
+
+        std::lock_guard<std::mutex> guard(lock_);
+        runNext();
+    }).detach();
+}
+
+uint64_t VirtualClock::switches() {
+    std::lock_guard<std::mutex> guard(lock_);
+    return switches_;
+}
+
+// Call with lock_ held: parks the running task until its deadline or a
+// notification on channel, whichever comes first
+void VirtualClock::park(std::unique_lock<std::mutex>& guard, int64_t deadline, const void* channel) {
+    int task = currentTask;
+    if (task < 0 || task != running_) {
+        fprintf(stderr, "VirtualClock: called from a thread it did not start\n");
+        abort();
+    }
+    Waiter waiter = { deadline, order_++, task, channel };
+    waiting_.push_back(waiter);
+    runNext();
+    waitTurn(guard, task);
+}
+
+// Call with lock_ held: hands the turn to the next ready task, moving time
+// on to the next deadline when there is none
+void VirtualClock::runNext() {
+    for (;;) {
+        // Waiters that are due, in deadline order, queue behind the ready tasks
+        std::vector<Waiter> due;
+        for (size_t i = 0; i < waiting_.size();) {
+            if (waiting_[i].deadline <= now_) {
+                due.push_back(waiting_[i]);
+                waiting_.erase(waiting_.begin() + i);
+            } else {
+                i++;
+            }
+        }
+        std::sort(due.begin(), due.end(), [](const Waiter& a, const Waiter& b) {
+            return a.deadline != b.deadline ? a.deadline < b.deadline : a.order < b.order;
+        });
+        for (const Waiter& waiter : due) {
+            ready_.push_back(waiter.task);
+        }
+        if (!ready_.empty()) {
+            break;
+        }
+
+        int64_t next = INT64_MAX;
+        for (const Waiter& waiter : waiting_) {
+            next = std::min(next, waiter.deadline);
+        }
+        if (next == INT64_MAX) {
+            fprintf(stderr, "VirtualClock: every task waits for good at %lld us\n", (long long)now_);
+            abort();
+        }
+        now_ = next;
+    }
+
+    int next = ready_.front();
+    ready_.pop_front();
+    if (next != running_) {
+        switches_++;
+    }
+    running_ = next;
+    turns_[next]->notify_one();
+}
+
+// Call with lock_ held
+void VirtualClock::waitTurn(std::unique_lock<std::mutex>& guard, int task) {
+    std::condition_variable& turn = *turns_[task];
+    while (running_ != task) {
+        turn.wait(guard);
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "native_hal.h"
+
+// Simulated time for host runs that have to be fast and repeatable.
+//
+// Every thread started through spawn() is a task of this clock, and only one
+// task runs at a time: the others are parked inside sleepMicros(),
+// waitMicros() or the start of their body. A task gives up its turn only in
+// those calls, ready tasks then run in the order they became ready. When none
+// is ready, time jumps straight to the earliest deadline, so a day of
+// delay(100) and long polls passes in seconds of real time, and the same
+// inputs always interleave the same way.
+//
+// The thread that creates the clock is the first task. Threads not started
+// through spawn() must not call into it. If every task waits without a
+// deadline nothing could ever run again, the clock reports it and aborts.
+class VirtualClock : public HalClock {
+public:
+    VirtualClock();
+
+    int64_t nowMicros() override;
+    void sleepMicros(int64_t us) override;
+    void waitMicros(std::unique_lock<std::mutex>& lock, std::condition_variable& cv, int64_t us) override;
+    void notifyAll(std::condition_variable& cv) override;
+    void spawn(std::function<void()> body) override;
+
+    // Turns handed from one task to another so far
+    uint64_t switches();
+
+private:
+    struct Waiter {
+        int64_t deadline;           // INT64_MAX = until notified
+        uint64_t order;
+        int task;
+        const void* channel;        // condition variable, nullptr for a sleep
+    };
+
+    void park(std::unique_lock<std::mutex>& guard, int64_t deadline, const void* channel);
+    void runNext();
+    void waitTurn(std::unique_lock<std::mutex>& guard, int task);
+
+    std::mutex lock_;
+    std::vector<std::unique_ptr<std::condition_variable>> turns_;   // one per task
+    std::deque<int> ready_;
+    std::vector<Waiter> waiting_;
+    int running_ = 0;
+    int64_t now_ = 0;
+    uint64_t order_ = 0;
+    uint64_t switches_ = 0;
+};
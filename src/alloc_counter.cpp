@@ -0,0 +1,66 @@
+#include <Arduino.h>
+#include "alloc_counter.h"
+
+#if ALLOC_COUNTER
+
+static void* trackedTask = nullptr;
+static volatile uint32_t trackedCount = 0;
+static volatile uint32_t totalCount = 0;
+
+static inline void countAllocation() {
+    totalCount++;
+    if (trackedTask && xTaskGetCurrentTaskHandle() == trackedTask) {
+        trackedCount++;
+    }
+}
+
+extern "C" {
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+void* __wrap_malloc(size_t size) {
+    countAllocation();
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    countAllocation();
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    countAllocation();
+    return __real_realloc(ptr, size);
+}
+
+}
+
+void trackTaskAllocations(void* taskHandle) {
+    trackedTask = taskHandle;
+}
+
+uint32_t taskAllocations() {
+    return trackedCount;
+}
+
+uint32_t totalAllocations() {
+    return totalCount;
+}
+
+#else
+
+void trackTaskAllocations(void* taskHandle) {
+    (void)taskHandle;
+}
+
+uint32_t taskAllocations() {
+    return 0;
+}
+
+uint32_t totalAllocations() {
+    return 0;
+}
+
+#endif
@@ -0,0 +1,193 @@
+// Host benchmark for the event log's compact encoding.
+//
+// Encodes synthetic shop days (shutter, doors, drawer and desk occupancy at
+// realistic intervals) with event_codec.h and compares the size with the
+// text lines the old pending_messages.txt held, then times encoding and
+// decoding. Reports bytes per event, how many events the 128 KB event log
+// partition holds either way, and ns per event.
+//
+//   pio run -e bench_event_codec -t exec
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <vector>
+#include "event_codec.h"
+#include "sensors.h"
+
+namespace {
+
+const size_t partitionSize = 0x20000;
+const size_t sectorSize = 4096;
+const size_t sectorHeaderSize = 32;
+
+uint32_t rngState = 12345;
+
+uint32_t nextRandom() {
+    rngState = rngState * 1103515245 + 12345;
+    return rngState >> 8;
+}
+
+// Sensors that have a message for the given direction
+bool hasMessage(uint8_t sensor, bool active) {
+    return (active ? sensorTable[sensor].onActive : sensorTable[sensor].onInactive) != nullptr;
+}
+
+// Events meanDelay_ms apart on average; a few are stored before the clock
+// was known, on the RTC timer of the power-up instead
+std::vector<EventRecord> makeEvents(size_t count, uint32_t meanDelay_ms) {
+    std::vector<EventRecord> events;
+    int64_t now = 1760000000000LL;
+    while (events.size() < count) {
+        now += 50 + nextRandom() % (2 * meanDelay_ms);
+        EventRecord record = {};
+        record.time_ms = now;
+        if (nextRandom() % 20 == 0) {
+            record.type = 1;    // vacancy
+        } else {
+            record.sensor = nextRandom() % sensorCount;
+            record.active = nextRandom() % 2;
+            if (!hasMessage(record.sensor, record.active)) {
+                continue;
+            }
+        }
+        if (events.size() % 500 < 5) {
+            record.timeSession = 0x5EED0001;
+            record.time_ms = now % 3600000;
+        }
+        events.push_back(record);
+    }
+    return events;
+}
+
+// The line the text log used to store for an event
+size_t textLength(const EventRecord& record) {
+    const char* messageTemplate = vacancyMessage;
+    if (record.type == 0) {
+        const SensorDescriptor& sensor = sensorTable[record.sensor];
+        messageTemplate = record.active ? sensor.onActive : sensor.onInactive;
+    }
+    char timestamp[24];
+    time_t seconds = (time_t)(record.time_ms / 1000);
+    struct tm timeinfo;
+    gmtime_r(&seconds, &timeinfo);
+    strftime(timestamp, sizeof(timestamp), "%d/%m/%Y %H:%M:%S", &timeinfo);
+
+    char line[160];
+    return snprintf(line, sizeof(line), messageTemplate, timestamp) + 1;   // println's newline
+}
+
+// Encodes like the log does: a new sector, with a fresh time base, whenever
+// the next entry does not fit
+size_t encodeAll(const std::vector<EventRecord>& events, std::vector<uint8_t>& out, size_t* sectors) {
+    out.assign(events.size() * eventEncodedMax, 0xFF);
+    size_t length = 0;
+    size_t inSector = sectorSize;
+    *sectors = 0;
+    EventTimeBase base = {};
+    for (const EventRecord& record : events) {
+        uint8_t entry[eventEncodedMax];
+        EventTimeBase next = base;
+        size_t entryLength = encodeEvent(record, next, entry);
+        if (inSector + entryLength > sectorSize) {
+            (*sectors)++;
+            inSector = sectorHeaderSize;
+            base = eventTimeBase(record);
+            next = base;
+            entryLength = encodeEvent(record, next, entry);
+        }
+        memcpy(out.data() + length, entry, entryLength);
+        length += entryLength;
+        inSector += entryLength;
+        base = next;
+    }
+    out.resize(length);
+    return length;
+}
+
+volatile uint64_t sink = 0;
+
+// Decodes a stream that encodeAll() wrote without sector breaks
+size_t decodeAll(const std::vector<uint8_t>& in, EventTimeBase base) {
+    size_t offset = 0;
+    size_t count = 0;
+    EventRecord record;
+    size_t consumed = 0;
+    while (decodeEvent(in.data() + offset, in.size() - offset, base, record, &consumed) == EVENT_DECODED) {
+        offset += consumed;
+        sink += record.time_ms + record.sensor;
+        count++;
+    }
+    return count;
+}
+
+template <typename TRun>
+double nanosPerEvent(TRun run, size_t events, int repetitions) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repetitions; i++) {
+        run();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / repetitions / events;
+}
+
+}  // namespace
+
+int main() {
+    printf("event log encoding, text lines (old pending file) vs event_codec.h\n");
+    printf("%u KB partition, %u byte sectors\n\n", (unsigned)(partitionSize / 1024), (unsigned)sectorSize);
+    printf("%10s | %8s %8s | %10s %10s %6s | %9s %9s\n",
+           "mean gap", "text B/e", "bin B/e", "text evts", "bin evts", "ratio", "enc ns/e", "dec ns/e");
+
+    const size_t count = 20000;
+    const uint32_t gaps[] = { 2000, 60000, 600000, 3600000 };
+    for (uint32_t gap : gaps) {
+        std::vector<EventRecord> events = makeEvents(count, gap);
+
+        size_t textBytes = 0;
+        for (const EventRecord& record : events) {
+            textBytes += textLength(record);
+        }
+
+        std::vector<uint8_t> encoded;
+        size_t sectors = 0;
+        size_t binaryBytes = encodeAll(events, encoded, &sectors);
+        double binaryPerEvent = (double)(binaryBytes + sectors * sectorHeaderSize) / count;
+        double textPerEvent = (double)textBytes / count;
+
+        // Round trip, without sector breaks so one time base covers it all
+        std::vector<uint8_t> stream(count * eventEncodedMax);
+        EventTimeBase start = eventTimeBase(events[0]);
+        EventTimeBase base = start;
+        size_t length = 0;
+        for (const EventRecord& record : events) {
+            length += encodeEvent(record, base, stream.data() + length);
+        }
+        stream.resize(length);
+        size_t decoded = decodeAll(stream, start);
+        if (decoded != count) {
+            printf("round trip decoded %u of %u events\n", (unsigned)decoded, (unsigned)count);
+            return 1;
+        }
+
+        std::vector<uint8_t> scratch(count * eventEncodedMax);
+        double encodeNs = nanosPerEvent([&]() {
+            EventTimeBase b = start;
+            size_t n = 0;
+            for (const EventRecord& record : events) {
+                n += encodeEvent(record, b, scratch.data() + n);
+            }
+            sink += n;
+        }, count, 50);
+        double decodeNs = nanosPerEvent([&]() { decodeAll(stream, start); }, count, 50);
+
+        size_t textCapacity = (size_t)(partitionSize / textPerEvent);
+        size_t binaryCapacity = (size_t)(partitionSize / binaryPerEvent);
+        printf("%8u s | %8.1f %8.2f | %10u %10u %5.1fx | %9.1f %9.1f\n",
+               (unsigned)(gap / 1000), textPerEvent, binaryPerEvent,
+               (unsigned)textCapacity, (unsigned)binaryCapacity, (double)binaryCapacity / textCapacity,
+               encodeNs, decodeNs);
+    }
+    return 0;
+}
@@ -0,0 +1,529 @@
+// End-to-end benchmark: how long from a sensor pin changing to its line
+// arriving at the Telegram Bot API, and how many of them get through a second.
+//
+// The unchanged firmware runs on the VirtualClock of lib/native_hal, as in
+// the sensor simulator: setup(), then loop() with the notifier, command, WiFi
+// and SNTP tasks alongside. A player task flips the contact sensors' pins
+// and takes the access point away and back; every flip is timestamped when
+// the pin changes. The in-process FakeTelegramApi, the same one the stand-in
+// of src/standin serves, timestamps every sendMessage when it takes it,
+// after its response latency, and each line in it is paired with the oldest
+// undelivered flip of the same sensor and direction.
+//
+// Scenarios run one after the other on the same boot, each once the previous
+// one has been delivered completely:
+//
+//   idle       single changes, well apart
+//   burst      a change every 100 ms, round robin over the contacts
+//   offline    changes during a short WiFi outage, sent on reconnect
+//   backlog    a long outage with hundreds of changes, drained from the event log
+//
+// Per scenario it reports p50 / p99 / max latency and the throughput, changes
+// delivered per second from the first change to the last delivery; for the
+// outages from the access point coming back, as the drain time. Times are
+// simulated, so the results are the same on every host and only change with
+// the firmware's own timing: loop period, coalescing, pacing, reconnect
+// backoff and replay.
+//
+//   pio run -e bench_latency -t exec
+//   .pio/build/bench_latency/program --json before.json --label main
+//
+// Options: --json FILE (results as JSON, - for stdout), --label TEXT (stored
+// in the JSON to tell builds apart), --only NAME (run one scenario),
+// --latency MS (Telegram response time, 200), --group-limit N (sends a minute
+// the group allows, 20, 0 = no limit), --seed N (jitter of the change times),
+// --serial (show the firmware's Serial output), --strict (exit with 1 when a
+// change is never delivered).
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <Arduino.h>
+#include "esp_partition.h"
+#include "native_hal.h"
+#include "virtual_clock.h"
+#include "sensors.h"
+#include "notifier.h"
+
+namespace {
+
+struct Options {
+    const char* jsonPath = nullptr;
+    const char* label = "";
+    const char* only = nullptr;
+    int64_t latency_us = 200000;
+    uint32_t groupPerMinute = 20;
+    uint32_t seed = 1;
+    bool serial = false;
+    bool strict = false;
+};
+
+// One pin change the player made
+struct Injection {
+    size_t scenario;
+    int key;
+    int64_t injected_us;
+    int64_t delivered_us;       // -1 until its line arrives
+    uint32_t message;           // index of the sendMessage that carried it
+};
+
+struct ScenarioResult {
+    const char* name;
+    uint32_t injected = 0;
+    uint32_t delivered = 0;
+    uint32_t messages = 0;
+    int64_t p50_us = 0;
+    int64_t p99_us = 0;
+    int64_t max_us = 0;
+    int64_t mean_us = 0;
+    int64_t span_us = 0;        // first change to last delivery
+    int64_t drain_us = -1;      // access point back to last delivery, outages only
+    double throughput = 0;      // delivered changes per second of the drain, else of the span
+};
+
+// Only touched under lock, the observer runs on the notifier task
+std::mutex lock;
+std::vector<Injection> injections;
+std::vector<std::deque<size_t>> undelivered;     // per key, oldest first
+uint32_t sentMessages = 0;
+uint32_t unexpectedLines = 0;
+uint32_t otherLines = 0;
+
+std::atomic<bool> finished(false);
+uint32_t rngState = 1;
+
+uint32_t nextRandom() {
+    rngState = rngState * 1103515245 + 12345;
+    return rngState >> 8;
+}
+
+// --- notifications ---
+
+// One key per sensor and direction, as in the sensor simulator
+int sensorKey(size_t sensor, bool active) {
+    return (int)(sensor * 2 + (active ? 1 : 0));
+}
+
+const int keyCount = (int)(sensorCount * 2);
+
+// Which sensor change a delivered line reports, by the template text
+// before %s; -1 for anything else
+int templateKey(const std::string& line) {
+    for (int key = 0; key < keyCount; key++) {
+        const SensorDescriptor& sensor = sensorTable[key / 2];
+        const char* messageTemplate = key % 2 ? sensor.onActive : sensor.onInactive;
+        if (!messageTemplate) {
+            continue;
+        }
+        size_t prefix = strstr(messageTemplate, "%s") - messageTemplate;
+        if (line.size() > prefix && line.compare(0, prefix, messageTemplate, prefix) == 0) {
+            return key;
+        }
+    }
+    return -1;
+}
+
+void onMessage(const HalSentMessage& message) {
+    std::lock_guard<std::mutex> guard(lock);
+    uint32_t index = sentMessages++;
+    size_t start = 0;
+    while (start <= message.text.size()) {
+        size_t end = message.text.find('\n', start);
+        if (end == std::string::npos) {
+            end = message.text.size();
+        }
+        int key = templateKey(message.text.substr(start, end - start));
+        if (key < 0) {
+            otherLines++;
+        } else if (undelivered[key].empty()) {
+            unexpectedLines++;
+        } else {
+            Injection& injection = injections[undelivered[key].front()];
+            undelivered[key].pop_front();
+            injection.delivered_us = message.time_us;
+            injection.message = index;
+        }
+        start = end + 1;
+    }
+}
+
+size_t pendingCount() {
+    std::lock_guard<std::mutex> guard(lock);
+    size_t pending = 0;
+    for (const std::deque<size_t>& queue : undelivered) {
+        pending += queue.size();
+    }
+    return pending;
+}
+
+// --- the player ---
+
+// The contacts report both directions, the PIR inputs only arrivals, so the
+// player drives the contacts
+std::vector<size_t> contactSensors() {
+    std::vector<size_t> sensors;
+    for (size_t i = 0; i < sensorCount; i++) {
+        if (sensorTable[i].onActive && sensorTable[i].onInactive) {
+            sensors.push_back(i);
+        }
+    }
+    return sensors;
+}
+
+class Player {
+public:
+    Player(size_t scenario) : scenario_(scenario), contacts_(contactSensors()) {}
+
+    // Flips the next contact in turn, the same sensor comes round again
+    // after well over its settle time
+    void flip() {
+        size_t sensor = contacts_[next_++ % contacts_.size()];
+        const SensorDescriptor& descriptor = sensorTable[sensor];
+        int level = halReadPin(descriptor.pin) == HIGH ? LOW : HIGH;
+        bool active = (level == LOW) == descriptor.activeLow;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            Injection injection = { scenario_, sensorKey(sensor, active), halClock().nowMicros(), -1, 0 };
+            undelivered[injection.key].push_back(injections.size());
+            injections.push_back(injection);
+        }
+        halWritePin(descriptor.pin, level);
+    }
+
+    // Sleeps for us plus up to one loop() period, so changes fall on every
+    // phase of the loop
+    void wait(int64_t us) {
+        halClock().sleepMicros(us + (int64_t)(nextRandom() % 100000));
+    }
+
+    void setWifi(bool available) {
+        if (available) {
+            reconnected_us_ = halClock().nowMicros();
+        }
+        halSetWifiAvailable(available);
+    }
+
+    // Until every change so far has been delivered, or timeout_us has passed
+    void settle(int64_t timeout_us) {
+        HalClock& clock = halClock();
+        const int64_t deadline = clock.nowMicros() + timeout_us;
+        while (pendingCount() > 0 && clock.nowMicros() < deadline) {
+            clock.sleepMicros(100000);
+        }
+    }
+
+    int64_t reconnected() const { return reconnected_us_; }
+
+private:
+    size_t scenario_;
+    std::vector<size_t> contacts_;
+    size_t next_ = 0;
+    int64_t reconnected_us_ = -1;
+};
+
+void playIdle(Player& player) {
+    for (int i = 0; i < 30; i++) {
+        player.wait(20000000);
+        player.flip();
+    }
+}
+
+void playBurst(Player& player) {
+    for (int i = 0; i < 60; i++) {
+        player.flip();
+        halClock().sleepMicros(100000);
+    }
+}
+
+void playOffline(Player& player) {
+    player.setWifi(false);
+    player.wait(5000000);
+    for (int i = 0; i < 20; i++) {
+        player.flip();
+        player.wait(3000000);
+    }
+    player.wait(10000000);
+    player.setWifi(true);
+}
+
+void playBacklog(Player& player) {
+    player.setWifi(false);
+    player.wait(5000000);
+    for (int i = 0; i < 400; i++) {
+        player.flip();
+        halClock().sleepMicros(250000);
+    }
+    player.wait(10000000);
+    player.setWifi(true);
+}
+
+struct Scenario {
+    const char* name;
+    void (*play)(Player& player);
+};
+
+const Scenario scenarios[] = {
+    { "idle", playIdle },
+    { "burst", playBurst },
+    { "offline", playOffline },
+    { "backlog", playBacklog },
+};
+const size_t scenarioCount = sizeof(scenarios) / sizeof(scenarios[0]);
+
+// Delivery can take a while behind the rate limit and reconnect backoff
+const int64_t settleTimeout_us = (int64_t)30 * 60 * 1000000;
+
+std::vector<int64_t> reconnectTimes(scenarioCount, -1);
+
+void play(const Options* options, FakeTelegramApi* telegram) {
+    HalClock& clock = halClock();
+    // Boot: WiFi up and "connected to WiFi" sent, the clock set
+    const int64_t bootDeadline = clock.nowMicros() + (int64_t)120 * 1000000;
+    while (telegram->messages() == 0 && clock.nowMicros() < bootDeadline) {
+        clock.sleepMicros(100000);
+    }
+    clock.sleepMicros((int64_t)10 * 1000000);
+
+    for (size_t i = 0; i < scenarioCount; i++) {
+        if (options->only && strcmp(options->only, scenarios[i].name) != 0) {
+            continue;
+        }
+        Player player(i);
+        scenarios[i].play(player);
+        player.settle(settleTimeout_us);
+        reconnectTimes[i] = player.reconnected();
+        // Quiet spell, so the rate limit and coalescing start afresh
+        clock.sleepMicros((int64_t)60 * 1000000);
+    }
+    finished = true;
+}
+
+// --- results ---
+
+// Nearest rank
+int64_t percentile(const std::vector<int64_t>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t rank = (size_t)ceil(p * sorted.size());
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+ScenarioResult summarize(size_t scenario) {
+    ScenarioResult result;
+    result.name = scenarios[scenario].name;
+    std::vector<int64_t> latencies;
+    std::vector<uint32_t> messages;
+    int64_t first = INT64_MAX, last = 0, total = 0;
+    for (const Injection& injection : injections) {
+        if (injection.scenario != scenario) {
+            continue;
+        }
+        result.injected++;
+        first = std::min(first, injection.injected_us);
+        if (injection.delivered_us < 0) {
+            continue;
+        }
+        int64_t latency = injection.delivered_us - injection.injected_us;
+        latencies.push_back(latency);
+        total += latency;
+        last = std::max(last, injection.delivered_us);
+        messages.push_back(injection.message);
+    }
+    std::sort(latencies.begin(), latencies.end());
+    std::sort(messages.begin(), messages.end());
+    result.delivered = (uint32_t)latencies.size();
+    result.messages = (uint32_t)(std::unique(messages.begin(), messages.end()) - messages.begin());
+    if (result.delivered > 0) {
+        result.p50_us = percentile(latencies, 0.50);
+        result.p99_us = percentile(latencies, 0.99);
+        result.max_us = latencies.back();
+        result.mean_us = total / result.delivered;
+        result.span_us = last - first;
+        if (reconnectTimes[scenario] >= 0) {
+            result.drain_us = last - reconnectTimes[scenario];
+        }
+        // Nothing can go out during an outage, count from the reconnect
+        int64_t window = result.drain_us >= 0 ? result.drain_us : result.span_us;
+        result.throughput = window > 0 ? result.delivered * 1e6 / window : 0;
+    }
+    return result;
+}
+
+void printResults(const std::vector<ScenarioResult>& results) {
+    printf("%-8s %8s %9s %8s %9s %9s %9s %9s %9s %10s %8s\n", "scenario", "changes", "delivered", "messages",
+           "p50 s", "p99 s", "max s", "mean s", "span s", "changes/s", "drain s");
+    for (const ScenarioResult& result : results) {
+        printf("%-8s %8u %9u %8u %9.3f %9.3f %9.3f %9.3f %9.1f %10.2f", result.name, (unsigned)result.injected,
+               (unsigned)result.delivered, (unsigned)result.messages, result.p50_us / 1e6, result.p99_us / 1e6,
+               result.max_us / 1e6, result.mean_us / 1e6, result.span_us / 1e6, result.throughput);
+        if (result.drain_us >= 0) {
+            printf(" %8.1f\n", result.drain_us / 1e6);
+        } else {
+            printf(" %8s\n", "-");
+        }
+    }
+}
+
+// Label text goes into a JSON string
+std::string jsonString(const char* text) {
+    std::string quoted = "\"";
+    for (const char* c = text; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            quoted += '\\';
+            quoted += *c;
+        } else if ((uint8_t)*c >= 0x20) {
+            quoted += *c;
+        }
+    }
+    return quoted + "\"";
+}
+
+// One object per run; latencies in ms, so builds can be diffed with jq
+bool writeJson(const char* path, const Options& options, const std::vector<ScenarioResult>& results) {
+    FILE* file = strcmp(path, "-") == 0 ? stdout : fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "cannot write %s\n", path);
+        return false;
+    }
+    fprintf(file, "{\n  \"benchmark\": \"notify_latency\",\n  \"label\": %s,\n", jsonString(options.label).c_str());
+    fprintf(file, "  \"settings\": {\"latency_ms\": %lld, \"group_limit\": %u, \"seed\": %u, "
+                  "\"coalesce_window_ms\": %d, \"rate_burst\": %d, \"rate_interval_ms\": %d},\n",
+            (long long)(options.latency_us / 1000), (unsigned)options.groupPerMinute, (unsigned)options.seed,
+            NOTIFY_COALESCE_WINDOW_MS, NOTIFY_RATE_BURST, NOTIFY_RATE_INTERVAL_MS);
+    fprintf(file, "  \"unexpected_lines\": %u,\n  \"scenarios\": [", (unsigned)unexpectedLines);
+    for (size_t i = 0; i < results.size(); i++) {
+        const ScenarioResult& result = results[i];
+        fprintf(file, "%s\n    {\"name\": \"%s\", \"changes\": %u, \"delivered\": %u, \"lost\": %u, \"messages\": %u, "
+                      "\"p50_ms\": %.1f, \"p99_ms\": %.1f, \"max_ms\": %.1f, \"mean_ms\": %.1f, "
+                      "\"span_s\": %.3f, \"changes_per_s\": %.3f",
+                i > 0 ? "," : "", result.name, (unsigned)result.injected, (unsigned)result.delivered,
+                (unsigned)(result.injected - result.delivered), (unsigned)result.messages,
+                result.p50_us / 1e3, result.p99_us / 1e3, result.max_us / 1e3, result.mean_us / 1e3,
+                result.span_us / 1e6, result.throughput);
+        if (result.drain_us >= 0) {
+            fprintf(file, ", \"drain_s\": %.3f", result.drain_us / 1e6);
+        }
+        fprintf(file, "}");
+    }
+    fprintf(file, "\n  ]\n}\n");
+    return file == stdout ? fflush(file) == 0 : fclose(file) == 0;
+}
+
+void usage() {
+    fprintf(stderr, "usage: notify_latency_bench [--json FILE] [--label TEXT] [--only idle|burst|offline|backlog]\n"
+                    "                            [--latency MS] [--group-limit N] [--seed N] [--serial] [--strict]\n");
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (strcmp(arg, "--serial") == 0) {
+            options.serial = true;
+        } else if (strcmp(arg, "--strict") == 0) {
+            options.strict = true;
+        } else if (!value) {
+            return false;
+        } else if (strcmp(arg, "--json") == 0) {
+            options.jsonPath = value;
+            i++;
+        } else if (strcmp(arg, "--label") == 0) {
+            options.label = value;
+            i++;
+        } else if (strcmp(arg, "--only") == 0) {
+            options.only = value;
+            i++;
+        } else if (strcmp(arg, "--latency") == 0) {
+            options.latency_us = (int64_t)atol(value) * 1000;
+            i++;
+        } else if (strcmp(arg, "--group-limit") == 0) {
+            options.groupPerMinute = (uint32_t)strtoul(value, nullptr, 10);
+            i++;
+        } else if (strcmp(arg, "--seed") == 0) {
+            options.seed = (uint32_t)strtoul(value, nullptr, 10);
+            i++;
+        } else {
+            return false;
+        }
+    }
+    if (options.only) {
+        for (const Scenario& scenario : scenarios) {
+            if (strcmp(options.only, scenario.name) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        usage();
+        return 2;
+    }
+    rngState = options.seed;
+    undelivered.resize(keyCount);
+
+    // Everything from here on runs on simulated time
+    static VirtualClock clock;
+    static FakeTelegramApi telegram;
+    halSetClock(&clock);
+    halSetHttp(&telegram);
+    telegram.setEcho(false);
+    telegram.setLatency(options.latency_us);
+    HalApiFaults faults;
+    faults.groupPerMinute = options.groupPerMinute;
+    telegram.setFaults(faults, options.seed);
+    telegram.onMessage(onMessage);
+    halSetSerialOutput(options.serial ? stdout : nullptr);
+
+    // As in partitions.csv
+    halAddPartition("evlog", ESP_PARTITION_TYPE_DATA, 0x40, 0x20000);
+
+    // Contacts start closed and the PIR inputs quiet, LOW on all of them
+    for (size_t i = 0; i < sensorCount; i++) {
+        halWritePin(sensorTable[i].pin, LOW);
+    }
+
+    setup();
+    const Options* settings = &options;
+    FakeTelegramApi* api = &telegram;
+    clock.spawn([settings, api]() { play(settings, api); });
+    while (!finished) {
+        loop();
+    }
+
+    // --- results, the firmware's tasks are parked while main has the turn ---
+
+    std::vector<ScenarioResult> results;
+    uint32_t lost = 0;
+    for (size_t i = 0; i < scenarioCount; i++) {
+        if (!options.only || strcmp(options.only, scenarios[i].name) == 0) {
+            results.push_back(summarize(i));
+            lost += results.back().injected - results.back().delivered;
+        }
+    }
+    printResults(results);
+    printf("\n%u messages, %u other lines, %u lines matching no change, %.1f simulated minutes, %llu task switches\n",
+           (unsigned)sentMessages, (unsigned)otherLines, (unsigned)unexpectedLines, clock.nowMicros() / 60e6,
+           (unsigned long long)clock.switches());
+
+    bool ok = !options.jsonPath || writeJson(options.jsonPath, options, results);
+
+    // The firmware's tasks never return, leave without running destructors under them
+    fflush(stdout);
+    _exit(!ok ? 2 : options.strict && lost > 0 ? 1 : 0);
+}
@@ -0,0 +1,237 @@
+// Host benchmark for the getUpdates parser.
+//
+// Compares the streaming, filtered parser in telegram_updates.h with the
+// previous approach (copy the whole body into a string, then deserialize it
+// into a DynamicJsonDocument(4096)) on synthetic responses of growing size.
+// Reports peak heap, parse time and how many updates each path recovered.
+//
+//   pio run -e bench_updates -t exec
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <ArduinoJson.h>
+#include "telegram_updates.h"
+
+namespace {
+
+// ---- heap accounting -------------------------------------------------------
+
+size_t heapInUse = 0;
+size_t heapPeak = 0;
+
+// Every block carries its size in a 16 byte header, which keeps alignment
+const size_t headerSize = 16;
+
+void* trackedAlloc(size_t size) {
+    unsigned char* block = static_cast<unsigned char*>(malloc(size + headerSize));
+    if (!block) {
+        return nullptr;
+    }
+    *reinterpret_cast<size_t*>(block) = size;
+    heapInUse += size;
+    if (heapInUse > heapPeak) {
+        heapPeak = heapInUse;
+    }
+    return block + headerSize;
+}
+
+void trackedFree(void* ptr) {
+    if (!ptr) {
+        return;
+    }
+    unsigned char* block = static_cast<unsigned char*>(ptr) - headerSize;
+    heapInUse -= *reinterpret_cast<size_t*>(block);
+    free(block);
+}
+
+void* trackedRealloc(void* ptr, size_t size) {
+    void* fresh = trackedAlloc(size);
+    if (fresh && ptr) {
+        size_t old = *reinterpret_cast<size_t*>(static_cast<unsigned char*>(ptr) - headerSize);
+        memcpy(fresh, ptr, old < size ? old : size);
+        trackedFree(ptr);
+    }
+    return fresh;
+}
+
+struct TrackingAllocator {
+    void* allocate(size_t size) { return trackedAlloc(size); }
+    void deallocate(void* ptr) { trackedFree(ptr); }
+    void* reallocate(void* ptr, size_t size) { return trackedRealloc(ptr, size); }
+};
+
+typedef BasicJsonDocument<TrackingAllocator> TrackedDynamicJsonDocument;
+
+// ---- synthetic responses ---------------------------------------------------
+
+uint32_t rngState = 12345;
+
+uint32_t nextRandom() {
+    rngState = rngState * 1103515245 + 12345;
+    return rngState >> 8;
+}
+
+std::string randomText(size_t length) {
+    static const char words[] = "shop drawer shutter customer payment print xerox please check today ";
+    std::string text;
+    while (text.size() < length) {
+        text += words[nextRandom() % (sizeof(words) - 1)];
+    }
+    return text;
+}
+
+// Shaped like real supergroup traffic: every message carries sender and chat
+// objects, replies embed the whole message they answer.
+std::string makeResponse(int updates) {
+    std::string body = "{\"ok\":true,\"result\":[";
+    for (int i = 0; i < updates; i++) {
+        const bool reply = i % 4 == 0;
+        char head[320];
+        snprintf(head, sizeof(head),
+                 "{\"update_id\":%d,\"message\":{\"message_id\":%d,"
+                 "\"from\":{\"id\":5123456789,\"is_bot\":false,\"first_name\":\"Ravi\",\"username\":\"ravi_k\",\"language_code\":\"en\"},"
+                 "\"chat\":{\"id\":-1001234567890,\"title\":\"Bharat Multiservices\",\"type\":\"supergroup\"},"
+                 "\"date\":%u,",
+                 815000000 + i, 4000 + i, 1760000000u + i * 7);
+        if (i > 0) {
+            body += ",";
+        }
+        body += head;
+        if (reply) {
+            body += "\"reply_to_message\":{\"message_id\":3999,"
+                    "\"from\":{\"id\":6000000000,\"is_bot\":true,\"first_name\":\"Shop Bot\",\"username\":\"shop_bot\"},"
+                    "\"chat\":{\"id\":-1001234567890,\"title\":\"Bharat Multiservices\",\"type\":\"supergroup\"},"
+                    "\"date\":1759999000,\"text\":\"Shutter open at 16/10/2026 09:02:11\"},"
+                    "\"text\":\"status\"}}";
+        } else {
+            body += "\"text\":\"" + randomText(10 + nextRandom() % 400) + "\"}}";
+        }
+    }
+    body += "]}";
+    return body;
+}
+
+// ---- the two parse paths ---------------------------------------------------
+
+volatile uint32_t sink = 0;
+
+// What checkStatusCommand() used to do
+int parseBuffered(const std::string& body) {
+    std::string response(body);     // http.getString()
+    TrackedDynamicJsonDocument doc(4096);
+    deserializeJson(doc, response);
+
+    int count = 0;
+    for (JsonObject update : doc["result"].as<JsonArray>()) {
+        sink += update["message"]["date"].as<unsigned long>();
+        sink += strlen(update["message"]["text"] | "");
+        sink += update["message"].containsKey("reply_to_message");
+        count++;
+    }
+    return count;
+}
+
+struct MemoryReader {
+    const char* next;
+    const char* end;
+
+    int read() {
+        return next < end ? (unsigned char)*next++ : -1;
+    }
+
+    size_t readBytes(char* buffer, size_t length) {
+        size_t n = 0;
+        while (n < length && next < end) {
+            buffer[n++] = *next++;
+        }
+        return n;
+    }
+};
+
+int parseStreaming(const std::string& body, TelegramUpdateDocument& doc) {
+    MemoryReader reader = { body.data(), body.data() + body.size() };
+    int count = 0;
+    parseTelegramUpdates(reader, doc, [&count](const TelegramUpdate& update) {
+        sink += update.date + strlen(update.text) + update.isReply;
+        count++;
+    });
+    return count;
+}
+
+// ---- measurement -----------------------------------------------------------
+
+struct Measurement {
+    size_t peakHeap;
+    double parseMicros;
+    int recovered;
+};
+
+template <typename TParse>
+Measurement measure(TParse parse, int repetitions) {
+    Measurement result;
+
+    size_t baseline = heapInUse;
+    heapPeak = heapInUse;
+    result.recovered = parse();
+    result.peakHeap = heapPeak - baseline;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repetitions; i++) {
+        parse();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    result.parseMicros = std::chrono::duration<double, std::micro>(elapsed).count() / repetitions;
+    return result;
+}
+
+}  // namespace
+
+void* operator new(size_t size) {
+    void* ptr = trackedAlloc(size);
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept {
+    trackedFree(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    trackedFree(ptr);
+}
+
+int main() {
+    static TelegramUpdateDocument doc;
+    telegramUpdatesFilter();
+
+    printf("getUpdates parsing, buffered (String + DynamicJsonDocument(4096)) vs streaming + filter\n");
+    printf("streaming footprint: %u byte update document + %u byte filter, no heap\n\n",
+           (unsigned)sizeof(TelegramUpdateDocument), (unsigned)sizeof(StaticJsonDocument<256>));
+    printf("%8s %10s | %12s %10s %9s | %12s %10s %9s\n",
+           "updates", "body B", "buf heap B", "buf us", "buf got", "str heap B", "str us", "str got");
+
+    const int sizes[] = { 1, 5, 20, 100, 500 };
+    for (int updates : sizes) {
+        std::string body = makeResponse(updates);
+        int repetitions = updates >= 100 ? 50 : 500;
+
+        Measurement buffered = measure([&body]() { return parseBuffered(body); }, repetitions);
+        Measurement streaming = measure([&body]() { return parseStreaming(body, doc); }, repetitions);
+
+        printf("%8d %10u | %12u %10.1f %4d/%-4d | %12u %10.1f %4d/%-4d\n",
+               updates, (unsigned)body.size(),
+               (unsigned)buffered.peakHeap, buffered.parseMicros, buffered.recovered, updates,
+               (unsigned)streaming.peakHeap, streaming.parseMicros, streaming.recovered, updates);
+    }
+    return 0;
+}
@@ -0,0 +1,124 @@
+#include <Arduino.h>
+#include <WiFi.h>
+#include <Preferences.h>
+#include "command_channel.h"
+#include "telegram_client.h"
+#include "telegram_updates.h"
+
+static TelegramConnection* connection = nullptr;
+static CommandHandler commandHandler = nullptr;
+static Preferences commandPrefs;
+
+// Reused for every update, the only JSON memory the channel ever needs
+static TelegramUpdateDocument updateDoc;
+
+// 0 until the first poll after a fresh flash tells us where the queue ends
+static int32_t nextOffset = 0;
+static CommandChannelStats stats = {};
+
+// Reads through Stream::readBytes() so the stream timeout applies to every byte
+struct StreamReader {
+    Stream& stream;
+
+    int read() {
+        char c;
+        return stream.readBytes(&c, 1) == 1 ? (uint8_t)c : -1;
+    }
+
+    size_t readBytes(char* buffer, size_t length) {
+        return stream.readBytes(buffer, length);
+    }
+};
+
+static void storeOffset(int32_t offset) {
+    if (offset != nextOffset) {
+        nextOffset = offset;
+        commandPrefs.putInt("offset", offset);
+    }
+}
+
+// Returns false when the request or the response failed
+static bool pollUpdates() {
+    // Without a stored offset, only ask for the latest update and drop it, so
+    // a freshly flashed board does not answer old commands
+    const bool skipBacklog = nextOffset == 0;
+    String query = skipBacklog ? String("offset=-1")
+                               : "offset=" + String(nextOffset) + "&timeout=" + String(COMMAND_POLL_TIMEOUT_S);
+
+    stats.polls++;
+    int httpResponseCode = connection->get("getUpdates", query);
+    if (httpResponseCode != 200) {
+        Serial.printf("Failed to fetch updates, error code: %d\n", httpResponseCode);
+        connection->finish();
+        return false;
+    }
+
+    // Hand each update over as soon as it is parsed, straight off the socket
+    auto onUpdate = [skipBacklog](const TelegramUpdate& update) {
+        if (!skipBacklog) {
+            stats.updates++;
+            commandHandler(update.text, update.isReply);
+        }
+    };
+    StreamReader stream = { connection->stream() };
+    UpdatesParseSummary summary;
+    if (connection->contentLength() < 0) {
+        ChunkedReader<StreamReader> chunked(stream);
+        summary = parseTelegramUpdates(chunked, updateDoc, onUpdate);
+    } else {
+        summary = parseTelegramUpdates(stream, updateDoc, onUpdate);
+    }
+    connection->finish();
+
+    int32_t offset = summary.count > 0 ? summary.lastUpdateId + 1 : nextOffset;
+    if (summary.result == UPDATES_TOO_LARGE) {
+        // Never a command, step over it. Update ids are sequential, so when the
+        // id could not be read the guess still moves forward on every poll.
+        int32_t failed = summary.failedUpdateId >= 0 ? summary.failedUpdateId : max(offset, (int32_t)1);
+        Serial.printf("Skipping oversized update %d\n", (int)failed);
+        offset = failed + 1;
+    } else if (summary.result != UPDATES_OK) {
+        Serial.printf("Failed to parse updates (%d) after %d update(s)\n", summary.result, summary.count);
+    }
+
+    // A fresh queue with nothing in it yet still has to leave the "unknown" state
+    storeOffset(skipBacklog && offset == 0 ? 1 : offset);
+    return summary.result == UPDATES_OK || summary.result == UPDATES_TOO_LARGE;
+}
+
+static void commandTask(void* arg) {
+    (void)arg;
+    for (;;) {
+        if (!WiFi.isConnected()) {
+            vTaskDelay(pdMS_TO_TICKS(1000));
+            continue;
+        }
+
+        if (!pollUpdates()) {
+            stats.failures++;
+            vTaskDelay(pdMS_TO_TICKS(5000));
+        }
+    }
+}
+
+bool startCommandChannel(const char* botToken, CommandHandler handler) {
+    commandHandler = handler;
+
+    commandPrefs.begin("commands", false);
+    nextOffset = commandPrefs.getInt("offset", 0);
+
+    connection = new TelegramConnection(botToken);
+    connection->setTimeout((COMMAND_POLL_TIMEOUT_S + 10) * 1000);
+
+    if (xTaskCreatePinnedToCore(commandTask, "commands", 12288, nullptr, 1, nullptr, COMMAND_CHANNEL_CORE) != pdPASS) {
+        Serial.println("Failed to start command task");
+        return false;
+    }
+    return true;
+}
+
+CommandChannelStats getCommandChannelStats() {
+    CommandChannelStats snapshot = stats;
+    snapshot.nextOffset = nextOffset;
+    return snapshot;
+}
@@ -0,0 +1,150 @@
+#include "event_codec.h"
+
+// Tag byte: 0ktsssss for an event (k: vacancy, t: new state, s: sensor),
+// timeBaseTag for a time base entry. Erased flash reads 0xFF, which is
+// neither.
+static const uint8_t timeBaseTag = 0x80;
+static const uint8_t vacancyBit = 0x40;
+static const uint8_t activeBit = 0x20;
+static const uint8_t sensorBits = 0x1F;
+static const uint8_t erasedByte = 0xFF;
+
+// session (4) and time_s (8), little endian
+static const size_t timeBaseSize = 1 + 4 + 8 + 1;
+
+// Longest varint of a 64-bit value
+static const size_t varintMax = 10;
+
+static uint8_t crc8(const uint8_t* data, size_t length) {
+    uint8_t crc = 0;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static size_t putVarint(uint64_t value, uint8_t* out) {
+    size_t length = 0;
+    while (value >= 0x80) {
+        out[length++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[length++] = (uint8_t)value;
+    return length;
+}
+
+// Returns the bytes used, 0 when the varint is longer than allowed or runs
+// past the end
+static size_t getVarint(const uint8_t* in, size_t length, uint64_t* value) {
+    uint64_t result = 0;
+    for (size_t i = 0; i < length && i < varintMax; i++) {
+        result |= (uint64_t)(in[i] & 0x7F) << (7 * i);
+        if (!(in[i] & 0x80)) {
+            *value = result;
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+// Small deltas of either sign stay small
+static uint64_t zigzag(int64_t value) {
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static int64_t unzigzag(uint64_t value) {
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+static int64_t wholeSeconds(int64_t ms) {
+    return ms >= 0 ? ms / 1000 : (ms - 999) / 1000;
+}
+
+EventTimeBase eventTimeBase(const EventRecord& record) {
+    EventTimeBase base = { wholeSeconds(record.time_ms), record.timeSession };
+    return base;
+}
+
+size_t encodeEvent(const EventRecord& record, EventTimeBase& base, uint8_t* out) {
+    int64_t seconds = wholeSeconds(record.time_ms);
+    size_t length = 0;
+    if (record.timeSession != base.session) {
+        out[length++] = timeBaseTag;
+        for (int i = 0; i < 4; i++) {
+            out[length++] = (uint8_t)(record.timeSession >> (8 * i));
+        }
+        for (int i = 0; i < 8; i++) {
+            out[length++] = (uint8_t)((uint64_t)seconds >> (8 * i));
+        }
+        out[length] = crc8(out, length);
+        length++;
+        base.session = record.timeSession;
+        base.time_s = seconds;
+    }
+
+    uint8_t* entry = out + length;
+    size_t entryLength = 0;
+    entry[entryLength++] = (record.type != 0 ? vacancyBit : 0)
+                         | (record.active ? activeBit : 0)
+                         | (record.sensor & sensorBits);
+    entryLength += putVarint(zigzag(seconds - base.time_s), entry + entryLength);
+    entry[entryLength] = crc8(entry, entryLength);
+    entryLength++;
+
+    base.time_s = seconds;
+    return length + entryLength;
+}
+
+EventDecodeResult decodeEvent(const uint8_t* in, size_t length, EventTimeBase& base,
+                              EventRecord& record, size_t* consumed) {
+    size_t position = 0;
+    for (;;) {
+        if (position >= length || in[position] == erasedByte) {
+            return EVENT_END;
+        }
+
+        const uint8_t* entry = in + position;
+        size_t available = length - position;
+        uint8_t tag = entry[0];
+
+        if (tag == timeBaseTag) {
+            if (available < timeBaseSize || crc8(entry, timeBaseSize - 1) != entry[timeBaseSize - 1]) {
+                return EVENT_DAMAGED;
+            }
+            uint32_t session = 0;
+            uint64_t time = 0;
+            for (int i = 0; i < 4; i++) {
+                session |= (uint32_t)entry[1 + i] << (8 * i);
+            }
+            for (int i = 0; i < 8; i++) {
+                time |= (uint64_t)entry[5 + i] << (8 * i);
+            }
+            base.session = session;
+            base.time_s = (int64_t)time;
+            position += timeBaseSize;
+            continue;
+        }
+        if (tag & 0x80) {
+            return EVENT_DAMAGED;
+        }
+
+        uint64_t delta = 0;
+        size_t varintLength = getVarint(entry + 1, available - 1, &delta);
+        size_t entryLength = 1 + varintLength;
+        if (varintLength == 0 || entryLength >= available || crc8(entry, entryLength) != entry[entryLength]) {
+            return EVENT_DAMAGED;
+        }
+
+        base.time_s += unzigzag(delta);
+        record.time_ms = base.time_s * 1000;
+        record.timeSession = base.session;
+        record.type = (tag & vacancyBit) ? 1 : 0;
+        record.active = (tag & activeBit) ? 1 : 0;
+        record.sensor = tag & sensorBits;
+        *consumed = position + entryLength + 1;
+        return EVENT_DECODED;
+    }
+}
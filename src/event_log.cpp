@@ -0,0 +1,394 @@
+#include <Arduino.h>
+#include <esp_rom_crc.h>
+#include <esp_system.h>
+#include "event_log.h"
+
+static const uint32_t logMagic = 0x45564c33;   // "EVL3", bump when the layout changes
+
+static uint32_t headerCrc(const void* header, size_t length) {
+    return esp_rom_crc32_le(0, (const uint8_t*)header, length);
+}
+
+// Events appended but not written to flash yet. RTC slow memory keeps its
+// contents through every reset but a power loss.
+struct StagedEvents {
+    uint32_t magic;
+    uint32_t count;
+    EventRecord records[EVENT_LOG_STAGE_CAPACITY];
+    uint32_t check;
+};
+static RTC_NOINIT_ATTR StagedEvents staged;
+static const uint32_t stagedMagic = 0x53544731;    // "STG1"
+
+// CRC of the header and the records in use
+static uint32_t stagedCheck() {
+    size_t length = offsetof(StagedEvents, records) + staged.count * sizeof(EventRecord);
+    return esp_rom_crc32_le(0, (const uint8_t*)&staged, length);
+}
+
+bool EventLog::begin(const char* partitionLabel) {
+    lock_ = xSemaphoreCreateMutex();
+    partition_ = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, partitionLabel);
+    if (!partition_) {
+        Serial.printf("Event log partition \"%s\" not found\n", partitionLabel);
+        return false;
+    }
+    sectors_ = partition_->size / sectorSize;
+    prefs_.begin("eventlog", false);
+    recover();
+
+    // A power-up leaves random contents behind
+    bool intact = esp_reset_reason() != ESP_RST_POWERON
+               && staged.magic == stagedMagic
+               && staged.count <= EVENT_LOG_STAGE_CAPACITY
+               && staged.check == stagedCheck();
+    if (intact && staged.count > 0) {
+        Serial.printf("Event log: writing %u events staged before the reset\n", (unsigned)staged.count);
+        flushStaged();
+    } else if (!intact) {
+        staged.magic = stagedMagic;
+        staged.count = 0;
+        staged.check = stagedCheck();
+    }
+
+    stats_.sectors = sectors_;
+    stats_.size = head_ - tail_;
+    Serial.printf("Event log: %u unsent events, %u sectors\n",
+                  (unsigned)stats_.size, (unsigned)sectors_);
+    return true;
+}
+
+bool EventLog::readHeader(uint32_t sector, SectorHeader& header) {
+    return esp_partition_read(partition_, sector * sectorSize, &header, sizeof(header)) == ESP_OK
+        && header.magic == logMagic
+        && header.crc == headerCrc(&header, offsetof(SectorHeader, crc))
+        && header.sequence % sectors_ == sector;
+}
+
+// Position one past the last event of a sector
+uint32_t EventLog::sectorEnd(uint32_t sequence) {
+    for (uint32_t next = sequence + 1; next <= headSequence_; next++) {
+        SectorHeader header;
+        if (readHeader(next % sectors_, header) && header.sequence == next) {
+            return header.first;
+        }
+    }
+    return head_;
+}
+
+void EventLog::recover() {
+    bool found = false;
+    SectorHeader newest = {};
+    for (uint32_t sector = 0; sector < sectors_; sector++) {
+        SectorHeader header;
+        if (readHeader(sector, header) && (!found || header.sequence > newest.sequence)) {
+            newest = header;
+            found = true;
+        }
+    }
+    if (!found) {
+        head_ = 0;
+        tail_ = 0;
+        prefs_.putUInt("tail", 0);
+        return;
+    }
+
+    // Entries are written in order, the head is after the last one that decodes
+    started_ = true;
+    headSequence_ = newest.sequence;
+    writeBase_.time_s = newest.time_s;
+    writeBase_.session = newest.session;
+    esp_partition_read(partition_, (headSequence_ % sectors_) * sectorSize, sectorBuffer_, sectorSize);
+
+    uint32_t offset = headerSize;
+    uint32_t count = 0;
+    EventDecodeResult result;
+    for (;;) {
+        EventRecord record;
+        size_t consumed = 0;
+        result = decodeEvent(sectorBuffer_ + offset, sectorSize - offset, writeBase_, record, &consumed);
+        if (result != EVENT_DECODED) {
+            break;
+        }
+        offset += consumed;
+        count++;
+    }
+    writeOffset_ = offset;
+    // A write cut short before it reached the tag byte leaves bytes behind
+    // that cannot be written again until the sector is erased
+    for (uint32_t i = offset; i < sectorSize && i < offset + eventEncodedMax; i++) {
+        if (sectorBuffer_[i] != 0xFF) {
+            result = EVENT_DAMAGED;
+        }
+    }
+    if (result == EVENT_DAMAGED) {
+        writeOffset_ = sectorSize;
+        stats_.corruptSectors++;
+    }
+    head_ = newest.first + count;
+
+    // Oldest sector still intact; the one after the newest may have been
+    // half way through its erase
+    uint32_t oldest = headSequence_;
+    uint32_t first = newest.first;
+    while (oldest > 0 && headSequence_ - (oldest - 1) < sectors_) {
+        SectorHeader header;
+        if (!readHeader((oldest - 1) % sectors_, header) || header.sequence != oldest - 1) {
+            break;
+        }
+        oldest--;
+        first = header.first;
+    }
+
+    tail_ = prefs_.getUInt("tail", first);
+    if (tail_ < first || tail_ > head_) {
+        tail_ = tail_ > head_ ? head_ : first;
+        prefs_.putUInt("tail", tail_);
+    }
+}
+
+bool EventLog::startSector(uint32_t sequence, const EventRecord& record) {
+    // The sector still holds the events of sequence - sectors_, whatever of
+    // them has not been sent is lost
+    if (sequence >= sectors_) {
+        uint32_t kept = sectorEnd(sequence - sectors_);
+        if (tail_ < kept) {
+            stats_.dropped += kept - tail_;
+            tail_ = kept;
+            prefs_.putUInt("tail", tail_);
+        }
+    }
+
+    uint32_t sector = sequence % sectors_;
+    headSequence_ = sequence;
+    started_ = true;
+    writeOffset_ = sectorSize;
+    if (esp_partition_erase_range(partition_, sector * sectorSize, sectorSize) != ESP_OK) {
+        return false;
+    }
+    stats_.sectorErases++;
+
+    EventTimeBase base = eventTimeBase(record);
+    SectorHeader header = { logMagic, sequence, head_, base.session, base.time_s, 0xFFFFFFFF, 0 };
+    header.crc = headerCrc(&header, offsetof(SectorHeader, crc));
+    if (esp_partition_write(partition_, sector * sectorSize, &header, sizeof(header)) != ESP_OK) {
+        return false;
+    }
+    writeOffset_ = headerSize;
+    writeBase_ = base;
+    return true;
+}
+
+bool EventLog::append(const EventRecord& record) {
+    if (!partition_) {
+        return false;
+    }
+
+    xSemaphoreTake(lock_, portMAX_DELAY);
+    if (staged.count == EVENT_LOG_STAGE_CAPACITY) {
+        // flushIfDue() has not kept up, this caller pays for the write
+        flushStaged();
+    }
+    bool ok = staged.count < EVENT_LOG_STAGE_CAPACITY;
+    if (ok) {
+        if (staged.count == 0) {
+            firstStagedAt_ = millis();
+        }
+        staged.records[staged.count++] = record;
+        staged.check = stagedCheck();
+    }
+    xSemaphoreGive(lock_);
+    return ok;
+}
+
+void EventLog::flushIfDue() {
+    if (!partition_) {
+        return;
+    }
+
+    xSemaphoreTake(lock_, portMAX_DELAY);
+    bool due = staged.count >= EVENT_LOG_FLUSH_COUNT
+            || (staged.count > 0 && millis() - firstStagedAt_ >= EVENT_LOG_FLUSH_MS);
+    if (due) {
+        flushStaged();
+    }
+    xSemaphoreGive(lock_);
+}
+
+void EventLog::flush() {
+    if (!partition_) {
+        return;
+    }
+
+    xSemaphoreTake(lock_, portMAX_DELAY);
+    flushStaged();
+    xSemaphoreGive(lock_);
+}
+
+// Call with lock_ held. The entries that go to the same sector are written
+// in one go; what could not be written stays staged.
+void EventLog::flushStaged() {
+    if (staged.count == 0) {
+        return;
+    }
+
+    uint8_t run[EVENT_LOG_STAGE_CAPACITY * eventEncodedMax];
+    size_t runLength = 0;
+    uint32_t runEvents = 0;
+    uint32_t written = 0;
+    EventTimeBase base = writeBase_;
+    bool ok = true;
+    for (uint32_t i = 0; i < staged.count; i++) {
+        const EventRecord& record = staged.records[i];
+        EventTimeBase next = base;
+        size_t length = encodeEvent(record, next, run + runLength);
+        if (!started_ || writeOffset_ + runLength + length > sectorSize) {
+            // Finish the sector, the event starts the next one
+            if (!writeRun(run, runLength, runEvents, base)) {
+                ok = false;
+                break;
+            }
+            written += runEvents;
+            runLength = 0;
+            runEvents = 0;
+            if (!startSector(started_ ? headSequence_ + 1 : 0, record)) {
+                ok = false;
+                break;
+            }
+            next = writeBase_;
+            length = encodeEvent(record, next, run);
+        }
+        runLength += length;
+        runEvents++;
+        base = next;
+    }
+    if (ok && writeRun(run, runLength, runEvents, base)) {
+        written += runEvents;
+    }
+
+    memmove(staged.records, staged.records + written, (staged.count - written) * sizeof(EventRecord));
+    staged.count -= written;
+    staged.check = stagedCheck();
+    firstStagedAt_ = millis();
+    stats_.flushes++;
+}
+
+// Call with lock_ held. Appends encoded entries to the sector being written,
+// base is the time base after the last of them.
+bool EventLog::writeRun(const uint8_t* run, size_t length, uint32_t events, const EventTimeBase& base) {
+    if (length == 0) {
+        return true;
+    }
+    uint32_t address = (headSequence_ % sectors_) * sectorSize + writeOffset_;
+    if (esp_partition_write(partition_, address, run, length) != ESP_OK) {
+        // Whatever part of it made it to flash cannot be written over, carry
+        // on in the next sector
+        writeOffset_ = sectorSize;
+        Serial.println("Failed to write event log entries");
+        return false;
+    }
+    writeOffset_ += length;
+    writeBase_ = base;
+    head_ += events;
+    stats_.appended += events;
+    stats_.appendedBytes += length;
+    return true;
+}
+
+uint32_t EventLog::tail() {
+    xSemaphoreTake(lock_, portMAX_DELAY);
+    uint32_t position = tail_;
+    xSemaphoreGive(lock_);
+    return position;
+}
+
+uint32_t EventLog::head() {
+    xSemaphoreTake(lock_, portMAX_DELAY);
+    uint32_t position = head_;
+    xSemaphoreGive(lock_);
+    return position;
+}
+
+size_t EventLog::read(uint32_t& position, EventRecord* records, size_t max) {
+    if (!partition_) {
+        return 0;
+    }
+
+    xSemaphoreTake(lock_, portMAX_DELAY);
+    size_t count = 0;
+    // Events before the tail may have been overwritten already
+    if (position < tail_) {
+        max = 0;
+    }
+    while (count < max && position < head_) {
+        // Newest sector that starts at or before position
+        SectorHeader header;
+        uint32_t sequence = headSequence_;
+        bool found = false;
+        for (uint32_t back = 0; back < sectors_ && back <= headSequence_; back++, sequence--) {
+            if (readHeader(sequence % sectors_, header) && header.sequence == sequence && header.first <= position) {
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            break;
+        }
+        uint32_t end = sequence == headSequence_ ? head_ : sectorEnd(sequence);
+        if (esp_partition_read(partition_, (sequence % sectors_) * sectorSize, sectorBuffer_, sectorSize) != ESP_OK) {
+            break;
+        }
+
+        // Events are relative to the one before, decode from the start of the sector
+        EventTimeBase base = { header.time_s, header.session };
+        uint32_t offset = headerSize;
+        uint32_t index = header.first;
+        while (index < end && count < max) {
+            EventRecord record;
+            size_t consumed = 0;
+            if (decodeEvent(sectorBuffer_ + offset, sectorSize - offset, base, record, &consumed) != EVENT_DECODED) {
+                break;
+            }
+            offset += consumed;
+            if (index >= position) {
+                record.sequence = index;
+                records[count++] = record;
+                position = index + 1;
+            }
+            index++;
+        }
+        if (index < end && count < max) {
+            // The rest of the sector is unreadable. Count it once, replay
+            // reads the same stretch again after a failed send.
+            if (end > corruptThrough_) {
+                stats_.corruptEvents += end - (position > corruptThrough_ ? position : corruptThrough_);
+                corruptThrough_ = end;
+            }
+            position = end;
+        }
+    }
+    xSemaphoreGive(lock_);
+    return count;
+}
+
+void EventLog::release(uint32_t position) {
+    xSemaphoreTake(lock_, portMAX_DELAY);
+    if (position > tail_ && position <= head_) {
+        stats_.released += position - tail_;
+        tail_ = position;
+        prefs_.putUInt("tail", tail_);
+    }
+    xSemaphoreGive(lock_);
+}
+
+EventLogStats EventLog::stats() {
+    if (!lock_) {
+        return stats_;
+    }
+    xSemaphoreTake(lock_, portMAX_DELAY);
+    EventLogStats snapshot = stats_;
+    snapshot.staged = staged.count;
+    snapshot.size = head_ - tail_ + staged.count;
+    xSemaphoreGive(lock_);
+    return snapshot;
+}
@@ -0,0 +1,60 @@
+#include "form_body.h"
+
+FormBodyStream::FormBodyStream(const char* prefix, const char* value)
+    : prefix_(prefix), prefixLength_(strlen(prefix)), text_(value), textLength_(strlen(value)) {
+    size_ = prefixLength_ + urlEncodedLength(text_, textLength_);
+}
+
+void FormBodyStream::rewind() {
+    prefixPos_ = 0;
+    textPos_ = 0;
+    outLength_ = 0;
+    outPos_ = 0;
+    sent_ = 0;
+}
+
+// Makes sure out_ holds at least one byte that has not been read yet
+bool FormBodyStream::fill() {
+    if (outPos_ < outLength_) {
+        return true;
+    }
+    outPos_ = 0;
+    outLength_ = 0;
+    if (prefixPos_ < prefixLength_) {
+        out_[0] = prefix_[prefixPos_++];
+        outLength_ = 1;
+        return true;
+    }
+    if (textPos_ == textLength_) {
+        return false;
+    }
+    outLength_ = urlEncodeByte((uint8_t)text_[textPos_++], out_);
+    return true;
+}
+
+int FormBodyStream::read() {
+    if (sent_ >= size_ || !fill()) {
+        return -1;
+    }
+    sent_++;
+    return (uint8_t)out_[outPos_++];
+}
+
+int FormBodyStream::peek() {
+    if (sent_ >= size_ || !fill()) {
+        return -1;
+    }
+    return (uint8_t)out_[outPos_];
+}
+
+size_t FormBodyStream::readBytes(char* buffer, size_t length) {
+    size_t n = 0;
+    while (n < length) {
+        int c = read();
+        if (c < 0) {
+            break;
+        }
+        buffer[n++] = (char)c;
+    }
+    return n;
+}
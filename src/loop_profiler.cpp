@@ -0,0 +1,101 @@
+#include <Arduino.h>
+#include <esp_timer.h>
+#include "loop_profiler.h"
+
+static const char* const stageNames[LOOP_STAGE_COUNT + 1] = {
+    "wifi", "clock", "event log", "sensors", "status", "delay", "period",
+};
+
+const char* loopStageName(LoopStage stage) {
+    return stage <= LOOP_PERIOD ? stageNames[stage] : "?";
+}
+
+#if LOOP_PROFILER
+
+struct StageHistogram {
+    uint32_t count;
+    uint32_t max_us;
+    uint64_t total_us;
+    uint32_t buckets[LOOP_PROFILE_BUCKETS];
+};
+
+// Written by loop(), read by whichever task builds the status report
+static StageHistogram histograms[LOOP_STAGE_COUNT + 1];
+static portMUX_TYPE profileLock = portMUX_INITIALIZER_UNLOCKED;
+
+// Only touched by loop()
+static int64_t iterationStart_us = 0;
+static int64_t lastMark_us = 0;
+
+static void record(LoopStage stage, int64_t duration_us) {
+    uint32_t us = duration_us > UINT32_MAX ? UINT32_MAX : (uint32_t)duration_us;
+    size_t bucket = us < 2 ? 0 : 31 - __builtin_clz(us);
+    if (bucket >= LOOP_PROFILE_BUCKETS) {
+        bucket = LOOP_PROFILE_BUCKETS - 1;
+    }
+    StageHistogram& histogram = histograms[stage];
+    portENTER_CRITICAL(&profileLock);
+    histogram.count++;
+    histogram.total_us += us;
+    if (us > histogram.max_us) {
+        histogram.max_us = us;
+    }
+    histogram.buckets[bucket]++;
+    portEXIT_CRITICAL(&profileLock);
+}
+
+void loopProfileStart() {
+    int64_t now = esp_timer_get_time();
+    if (iterationStart_us != 0) {
+        record(LOOP_PERIOD, now - iterationStart_us);
+    }
+    iterationStart_us = now;
+    lastMark_us = now;
+}
+
+void loopProfileEnd(LoopStage stage) {
+    int64_t now = esp_timer_get_time();
+    record(stage, now - lastMark_us);
+    lastMark_us = now;
+}
+
+LoopStageStats getLoopStageStats(LoopStage stage) {
+    LoopStageStats stats = {};
+    if (stage > LOOP_PERIOD) {
+        return stats;
+    }
+    StageHistogram histogram;
+    portENTER_CRITICAL(&profileLock);
+    histogram = histograms[stage];
+    portEXIT_CRITICAL(&profileLock);
+
+    stats.count = histogram.count;
+    stats.max_us = histogram.max_us;
+    memcpy(stats.buckets, histogram.buckets, sizeof(stats.buckets));
+    if (histogram.count == 0) {
+        return stats;
+    }
+    stats.mean_us = (uint32_t)(histogram.total_us / histogram.count);
+
+    // The last bucket has no upper edge, the maximum stands in for it
+    uint32_t rank = histogram.count - histogram.count / 100;
+    uint32_t seen = 0;
+    for (size_t i = 0; i < LOOP_PROFILE_BUCKETS; i++) {
+        seen += histogram.buckets[i];
+        if (seen >= rank) {
+            stats.p99_us = i + 1 < LOOP_PROFILE_BUCKETS ? min((uint32_t)2 << i, histogram.max_us) : histogram.max_us;
+            break;
+        }
+    }
+    return stats;
+}
+
+#else
+
+LoopStageStats getLoopStageStats(LoopStage stage) {
+    (void)stage;
+    LoopStageStats stats = {};
+    return stats;
+}
+
+#endif
@@ -1,506 +1,642 @@
 #include <WiFi.h>
-#include <HTTPClient.h>
 #include <time.h>
-#include <SPIFFS.h>
-#include <ArduinoJson.h>
+#include <atomic>
 #include "config.h"
+#include "spsc_ring.h"
+#include "sensors.h"
+#include "sensor_sampler.h"
+#include "sensor_debounce.h"
+#include "notifier.h"
+#include "telegram_client.h"
+#include "command_channel.h"
+#include "message_buffer.h"
+#include "alloc_counter.h"
+#include "wifi_manager.h"
+#include "time_service.h"
+#include "event_log.h"
+#include "loop_profiler.h"
+
+// 1 = capture sensor edges from GPIO interrupts, 0 = poll the pins once per loop()
+#ifndef SENSOR_EDGE_CAPTURE
+#define SENSOR_EDGE_CAPTURE 1
+#endif
 
 // Wi-Fi credentials
 const char* ssid = WIFI_NAME;
 const char* password = WIFI_PASS;
 
 // Telegram API details
-const String telegramBotToken = TELEGRAM_BOT_TOKEN; 
 const String telegramChatId = TELEGRAM_GRP_CHAT_ID;
+// Start of every sendMessage body, the url-encoded text follows
+const String sendMessagePrefix = "chat_id=" + telegramChatId + "&text=";
+
+// Keep-alive connection used by the notifier task, commands are polled on their own
+TelegramConnection telegram(TELEGRAM_BOT_TOKEN);
+
 // NTP server settings
 const char* ntpServer = "pool.ntp.org";
 const long gmtOffset_sec = 19800;    // Changed to 5 hours 30 minutes (5*3600 + 30*60)
 const int daylightOffset_sec = 0;    // India doesn't use daylight saving
-const int timeUpdateInterval = 1;    // Changed to 1 second from 60
-
-// Sensor pins
-const int pir1 = 13;
-const int pir2 = 12;
-const int shutter = 14;
-const int drawer = 27;
-const int officeDoor = 25;
-
-// Current sensor states
-bool wifi_connected = false;
-bool shutter_closed = false;
-bool drawer_closed = false;
-bool office_door_closed = false;
-bool desk1_occupied = false;
-bool desk2_occupied = false;
-
-// Previous sensor states for change detection
-bool prev_shutter_closed = false;
-bool prev_drawer_closed = false;
-bool prev_office_door_closed = false;
-bool prev_desk1_occupied = false;
-bool prev_desk2_occupied = false;
-bool prev_any_desk_occupied = false;
-
-// Time variables
-bool time_initialized = false;
-String current_timestamp = "01/01/1001 00:00:00*"; // This is dummy time stamp 
-
-// Persistent storage settings
-const String pendingMessagesFile = "/pending_messages.txt";
+
+// Sensor snapshots taken by the GPIO interrupt on every edge, drained by loop()
+struct SensorEdge {
+    uint32_t timestamp_us;
+    SensorMask state;
+};
+SpscRing<SensorEdge, 64> sensorEdges;
+uint32_t handled_edge_drops = 0;
+
+// Written by loop() on link changes, read by the notifier task before it
+// touches the network
+std::atomic<bool> wifi_connected(false);
+
+// Set by the command task when the group asks for a status report,
+// picked up by loop() so the report uses a consistent sensor snapshot
+std::atomic<bool> status_requested(false);
+
+// Heap allocations seen while sampling, debouncing and queueing events,
+// expected to stay at zero (needs an ALLOC_COUNTER build)
+uint32_t event_path_allocations = 0;
+
+// Current and previous debounced sensor states, one bit per sensorTable entry
+SensorMask sensor_state = 0;
+SensorMask prev_sensor_state = 0;
+SensorDebouncer sensorDebouncer;
+
+// Shown instead of the time until SNTP has set the clock
+const char* const placeholderTimestamp = "01/01/1001 00:00:00*"; // This is dummy time stamp
+
+// Message templates and buffer sizes, so the event path never needs the heap
+typedef MessageBuffer<128> EventLine;
+typedef MessageBuffer<1536> TelegramMessage;
+typedef MessageBuffer<telegramMessageLimit + 1> ReplayMessage;
+const char* const statusHeader = "Bharat Multiservices Status:\n\n";
+const char* const statusWifiLine = "1. WiFi : %s\n";
+const char* const statusSensorLine = "%u. %s: %s\n";
+const char* const statusTimeLine = "%u. Time: %s";
+
+// Sensor events that could not be sent, replayed once Telegram is reachable
+EventLog eventLog;
+
+// Progress of draining the event log, for the events/s report. Only touched
+// from the notifier task.
+struct ReplayStats {
+    int64_t started_us;     // first message of the drain under way, 0 when idle
+    uint32_t events;        // sent so far, or in the last drain when idle
+    uint32_t messages;
+    uint32_t duration_ms;   // of the last complete drain
+};
+ReplayStats replay_stats = {};
+
+// A send that failed with WiFi up (5xx, reset, timeout) leaves its events in
+// the event log and replays it after a backoff, doubling from the first to
+// the last value while sends keep failing. Only touched from the notifier task.
+const uint32_t sendRetryFirstMs = 5000;
+const uint32_t sendRetryMaxMs = 300000;
+uint32_t send_retry_ms = 0;         // backoff in effect, 0 after a successful send
+unsigned long send_retry_since = 0;
+bool send_retry_scheduled = false;
 
 // Function prototypes - declare all functions before setup()
-void connectToWifi();
-void initializeTime();
-void updateTime();
 void readSensorStates();
+void latchPreviousStates();
+void attachSensorInterrupts();
+void drainSensorEdges();
+void applySensorEdge(const SensorEdge& edge);
+void expireSettleTimers(uint32_t now_us);
 void processSensorChanges();
-void sendTelegramMessage(String message);
-String getTimeStamp();
-void savePendingMessage(String message);
-void sendPendingMessages();
-void trimPendingMessagesFile();
-void checkStatusCommand();
-void sendStatusUpdate();
-String urlEncode(String str);
+void queueNotification(NotifyEventType type, uint8_t sensor = 0, bool active = false);
+uint32_t deliverNotification(const NotifyEvent* events, size_t count);
+void renderEventLine(const NotifyEvent& event, EventLine& line);
+void renderRecordLine(const EventRecord& record, EventLine& line);
+void appendEventLine(EventLine& line, uint8_t type, uint8_t sensor, bool active, const char* timestamp);
+int sendTelegramMessage(const char* message);
+void formatEventTime(int64_t raised_us, char* buffer, size_t size);
+void logEvents(const NotifyEvent* events, size_t count);
+int replayEventLog();
+void scheduleSendRetry();
+void retryFailedSends();
+void handleCommand(const char* text, bool isReply);
+int sendStatusUpdate(SensorMask state, const char* timestamp);
 
 void setup() {
     Serial.begin(115200);
+    trackTaskAllocations(xTaskGetCurrentTaskHandle());
     
-    // Set pin modes with internal pullup resistors
-    pinMode(pir1, INPUT);
-    pinMode(pir2, INPUT);
-    pinMode(shutter, INPUT_PULLUP);
-    pinMode(drawer, INPUT_PULLUP);
-    pinMode(officeDoor, INPUT_PULLUP);
-
-    if (!SPIFFS.begin(true)) {
-        Serial.println("SPIFFS initialization failed");
-        return;
+    // Set pin modes, magnetic contacts use the internal pullup resistors
+    for (size_t i = 0; i < sensorCount; i++) {
+        pinMode(sensorTable[i].pin, sensorTable[i].pull == SENSOR_PULL_UP ? INPUT_PULLUP : INPUT);
     }
 
-    // // // Delete the pending messages file
-    // if(SPIFFS.exists(pendingMessagesFile)) {
-    //     SPIFFS.remove(pendingMessagesFile);
-    //     Serial.println("Deleted old pending messages file");
-    // }
+    // Without the partition events are only lost while offline, keep going.
+    // Nothing is read from the /pending_messages.txt of older firmware, see
+    // partitions.csv.
+    if (!eventLog.begin()) {
+        Serial.println("Event log unavailable, offline events will be lost");
+    }
+
+    // Everything that talks to Telegram from here on runs on the notifier
+    // and command tasks
+    startNotifier(deliverNotification, retryFailedSends, 1000);
+    startCommandChannel(TELEGRAM_BOT_TOKEN, handleCommand);
+
+    // Both run in the background, loop() never waits for them
+    startTimeService(ntpServer, gmtOffset_sec, daylightOffset_sec);
+    startWifi(ssid, password);
 
-    connectToWifi();
-    HTTPClient http;
-    String url = "https://api.telegram.org/bot" + telegramBotToken + "/getUpdates?offset=-1";
-    http.begin(url);
-    http.GET();
-    http.end();
-    initializeTime();
-    
     // Initialize previous states
+    sensorDebouncer.reset(sampleSensorInputs(), micros());
     readSensorStates();
-    prev_shutter_closed = shutter_closed;
-    prev_drawer_closed = drawer_closed;
-    prev_office_door_closed = office_door_closed;
-    prev_desk1_occupied = desk1_occupied;
-    prev_desk2_occupied = desk2_occupied;
-    prev_any_desk_occupied = desk1_occupied || desk2_occupied;
-
-    sendPendingMessages();
+    latchPreviousStates();
+
+#if SENSOR_EDGE_CAPTURE
+    attachSensorInterrupts();
+#endif
 }
 
 void loop() {
-    static unsigned long lastTimeSync = 0;
-    const unsigned long TIME_SYNC_INTERVAL = 300000; // Sync time every 5 minutes
-    // Check WiFi connection
-    if (WiFi.status() != WL_CONNECTED) {
-        if (wifi_connected) {
+    loopProfileStart();
+
+    // Reconnects are handled by the WiFi manager, this never blocks
+    switch (serviceWifi()) {
+        case WIFI_LINK_UP:
+            wifi_connected = true;
+            queueNotification(NOTIFY_WIFI_CONNECTED);
+            // SNTP re-syncs on its own, only hurry it while the clock is unset
+            if (!timeSynced()) {
+                requestTimeSync();
+            }
+            break;
+        case WIFI_LINK_DOWN:
             wifi_connected = false;
-            time_initialized = false;
-            Serial.println("WiFi disconnected");
-        }
-        connectToWifi();
-    }
-    // Periodic time sync check
-    if (wifi_connected && (millis() - lastTimeSync >= TIME_SYNC_INTERVAL)) {
-        Serial.println("Performing periodic time sync...");
-        initializeTime();
-        lastTimeSync = millis();
+            break;
+        default:
+            break;
     }
+    loopProfileEnd(LOOP_STAGE_WIFI);
 
-    // Update time if necessary
-    updateTime();
+    // Backlog replay waits for the clock, so events stored while it was
+    // unknown go out with their real time
+    static bool clock_known = false;
+    if (!clock_known && timeSynced()) {
+        clock_known = true;
+        if (wifi_connected) {
+            requestReplay();
+        }
+    }
+    persistTimeAnchor();
+    loopProfileEnd(LOOP_STAGE_CLOCK);
+    eventLog.flushIfDue();
+    loopProfileEnd(LOOP_STAGE_EVENT_LOG);
 
     // Read and process sensor states
+    uint32_t allocationsBefore = taskAllocations();
+#if SENSOR_EDGE_CAPTURE
+    drainSensorEdges();
+#else
     readSensorStates();
     processSensorChanges();
+#endif
+    loopProfileEnd(LOOP_STAGE_SENSORS);
+
+    // Status commands are picked up by the command task
+    if (status_requested.exchange(false)) {
+        queueNotification(NOTIFY_STATUS);
+    }
 
-    // Check for status command every 5 seconds
-    static unsigned long lastCheckTime = 0;
-    if (millis() - lastCheckTime >= 5000) {
-        checkStatusCommand();
-        lastCheckTime = millis();
+    uint32_t allocations = taskAllocations() - allocationsBefore;
+    if (allocations > 0) {
+        event_path_allocations += allocations;
+        Serial.printf("Event path allocated %u times\n", (unsigned)allocations);
     }
+    loopProfileEnd(LOOP_STAGE_STATUS);
 
     delay(100);
+    loopProfileEnd(LOOP_STAGE_DELAY);
 }
 
-void connectToWifi() {
-    if (WiFi.status() == WL_CONNECTED) {
-        wifi_connected = true;
-        return;
-    }
-
-    WiFi.begin(ssid, password);
-    Serial.print("Connecting to WiFi");
-    
-    int attempts = 0;
-    while (WiFi.status() != WL_CONNECTED && attempts < 2) {
-        delay(500);
-        Serial.print(".");
-        attempts++;
-    }
-    
-    if (WiFi.status() == WL_CONNECTED) {
-        Serial.println("\nWiFi connected");
-        Serial.println("IP address: " + WiFi.localIP().toString());
-        wifi_connected = true;
-        sendTelegramMessage("connected to WiFi");
-        sendPendingMessages();
-        initializeTime();
-    } else {
-        Serial.println("\nWiFi connection failed");
-        wifi_connected = false;
-    }
+void latchPreviousStates() {
+    prev_sensor_state = sensor_state;
 }
 
-void initializeTime() {
-    if (!wifi_connected) {
-        Serial.println("Cannot initialize time: WiFi not connected");
-        return;
-    }
+void readSensorStates() {
+    // Store previous states
+    latchPreviousStates();
 
-    configTime(gmtOffset_sec, daylightOffset_sec, ntpServer);
-    
-    int attempts = 0;
-    while (!time(nullptr) && attempts < 10) {
-        Serial.print(".");
-        delay(500);
-        attempts++;
-    }
+    // A set bit means closed / occupied, polarity is handled by the sampler
+    sensor_state = sensorDebouncer.sample(sampleSensorInputs(), micros());
+}
 
-    if (time(nullptr)) {
-        time_initialized = true;
-        current_timestamp = getTimeStamp();
-    } else {
-        time_initialized = false;
-    }
+void IRAM_ATTR onSensorEdge() {
+    // Snapshot every sensor, not just the pin that fired, so simultaneous
+    // changes arrive as one consistent sample
+    SensorEdge edge;
+    edge.timestamp_us = micros();
+    edge.state = sampleSensorInputs();
+    sensorEdges.push(edge);
 }
 
-void updateTime() {
-    static unsigned long lastTimeUpdate = 0;
-    
-    if (wifi_connected && (!time_initialized || (millis() - lastTimeUpdate >= timeUpdateInterval * 1000))) {
-        struct tm timeinfo;
-        if (getLocalTime(&timeinfo)) {
-            current_timestamp = getTimeStamp();
-            lastTimeUpdate = millis();
-            time_initialized = true;
-        } else {
-            // If we can't get the time but we're connected to WiFi, try to reinitialize
-            if (!time_initialized) {
-                Serial.println("Reinitializing time...");
-                initializeTime();
-            }
-        }
-    }
-    
-    // Only set default timestamp if we're not connected to WiFi
-    if (!wifi_connected) {
-        current_timestamp = "01/01/1001 00:00:00*";
-        time_initialized = false;
+void attachSensorInterrupts() {
+    for (size_t i = 0; i < sensorCount; i++) {
+        attachInterrupt(digitalPinToInterrupt(sensorTable[i].pin), onSensorEdge, CHANGE);
     }
 }
 
-void readSensorStates() {
-    // Store previous states
-    prev_shutter_closed = shutter_closed;
-    prev_drawer_closed = drawer_closed;
-    prev_office_door_closed = office_door_closed;
-    prev_desk1_occupied = desk1_occupied;
-    prev_desk2_occupied = desk2_occupied;
-    prev_any_desk_occupied = desk1_occupied || desk2_occupied;
-
-    // Read current states
-    // Note: LOW means closed for magnetic sensors due to pull-up resistors
-    shutter_closed = digitalRead(shutter) == LOW;
-    drawer_closed = digitalRead(drawer) == LOW;
-    office_door_closed = digitalRead(officeDoor) == LOW;
-    
-    // PIR sensors: HIGH means motion detected
-    desk1_occupied = digitalRead(pir1) == HIGH;
-    desk2_occupied = digitalRead(pir2) == HIGH;
+void applySensorEdge(const SensorEdge& edge) {
+    sensor_state = sensorDebouncer.update(edge.state, edge.timestamp_us);
 }
 
-void processSensorChanges() {
-    // Process state changes and send notifications
-    if (shutter_closed != prev_shutter_closed) {
-        sendTelegramMessage("Shutter " + String(shutter_closed ? "closed" : "open") + " at " + current_timestamp);
-    }
+// Changes that came due by now_us on the current inputs are reported on
+// their own, before whatever the next sample changes. Otherwise one sensor
+// going vacant and another going occupied in the same update() would hide
+// the vacancy in between.
+void expireSettleTimers(uint32_t now_us) {
+    latchPreviousStates();
+    sensor_state = sensorDebouncer.update(sensorDebouncer.raw(), now_us);
+    processSensorChanges();
+}
 
-    if (drawer_closed != prev_drawer_closed) {
-        sendTelegramMessage("Drawer " + String(drawer_closed ? "closed" : "open") + " at " + current_timestamp);
+void drainSensorEdges() {
+    // Every edge is processed on its own, so a pulse shorter than one loop()
+    // iteration still produces both of its notifications
+    SensorEdge edge;
+    while (sensorEdges.pop(edge)) {
+        expireSettleTimers(edge.timestamp_us);
+        latchPreviousStates();
+        applySensorEdge(edge);
+        processSensorChanges();
+    }
+
+    // Let settle timers expire even when the inputs have gone quiet
+    expireSettleTimers(micros());
+
+    // If the ring overflowed we no longer know the exact edge sequence,
+    // so fall back to a fresh read to get back in sync with the pins
+    uint32_t drops = sensorEdges.dropped();
+    if (drops != handled_edge_drops) {
+        Serial.printf("Sensor edge ring overflowed, %u edges dropped\n", drops - handled_edge_drops);
+        handled_edge_drops = drops;
+        readSensorStates();
+        processSensorChanges();
     }
+}
 
-    if (office_door_closed != prev_office_door_closed) {
-        sendTelegramMessage("Office door " + String(office_door_closed ? "closed" : "open") + " at " + current_timestamp);
+void queueNotification(NotifyEventType type, uint8_t sensor, bool active) {
+    NotifyEvent event;
+    event.type = type;
+    event.sensor = sensor;
+    event.active = active;
+    // Vacancy is occupancy chatter, status and WiFi messages rank with normal sensors
+    event.priority = type == NOTIFY_SENSOR_CHANGE ? sensorTable[sensor].priority
+                   : type == NOTIFY_VACANCY ? SENSOR_PRIORITY_LOW : SENSOR_PRIORITY_NORMAL;
+    event.state = sensor_state;
+    // Only the instant is recorded, it is turned into a date when rendered
+    event.raised_us = monotonicMicros();
+
+    if (!notify(event)) {
+        // Queue is full, keep the event in flash rather than losing it
+        Serial.println("Notifier queue full, logging event");
+        logEvents(&event, 1);
     }
+}
 
-    // Check for occupancy changes
-    bool current_any_desk_occupied = desk1_occupied || desk2_occupied;
-    if (current_any_desk_occupied != prev_any_desk_occupied) {
-        if (!current_any_desk_occupied) {
-            sendTelegramMessage("No employee present in the shop at " + current_timestamp);
-        }
-    }
+void renderEventLine(const NotifyEvent& event, EventLine& line) {
+    char timestamp[24];
+    formatEventTime(event.raised_us, timestamp, sizeof(timestamp));
+    appendEventLine(line, event.type, event.sensor, event.active, timestamp);
+}
 
-    if (desk1_occupied != prev_desk1_occupied && desk1_occupied) {
-        sendTelegramMessage("Employee is present at main Computer 1 at " + current_timestamp);
+void renderRecordLine(const EventRecord& record, EventLine& line) {
+    char timestamp[24];
+    StoredTime time = { record.time_ms, record.timeSession };
+    if (!formatStoredTime(time, timestamp, sizeof(timestamp))) {
+        strlcpy(timestamp, placeholderTimestamp, sizeof(timestamp));
     }
+    appendEventLine(line, record.type, record.sensor, record.active, timestamp);
+}
 
-    if (desk2_occupied != prev_desk2_occupied && desk2_occupied) {
-        sendTelegramMessage("Employee is present at Computer 2 at " + current_timestamp);
+void appendEventLine(EventLine& line, uint8_t type, uint8_t sensor, bool active, const char* timestamp) {
+    const char* messageTemplate = vacancyMessage;
+    if (type == NOTIFY_SENSOR_CHANGE) {
+        messageTemplate = active ? sensorTable[sensor].onActive : sensorTable[sensor].onInactive;
     }
+    line.appendf(messageTemplate, timestamp);
 }
 
-String getTimeStamp() {
-    struct tm timeinfo;
-    if (!getLocalTime(&timeinfo)) {
-        Serial.println("Failed to obtain time");
-        if (wifi_connected) {
-            // If we're connected but can't get time, try to reinitialize
-            initializeTime();
-            if (!getLocalTime(&timeinfo)) {
-                return "01/01/1001 00:00:00*";
+// Runs on the notifier task
+uint32_t deliverNotification(const NotifyEvent* events, size_t count) {
+    const NotifyEvent& event = events[0];
+    switch (event.type) {
+        case NOTIFY_SENSOR_CHANGE:
+        case NOTIFY_VACANCY: {
+            if (!wifi_connected) {
+                logEvents(events, count);
+                return 0;
+            }
+            // A coalesced batch goes out as one message, one line per event
+            static TelegramMessage message;
+            message.clear();
+            for (size_t i = 0; i < count; i++) {
+                EventLine line;
+                renderEventLine(events[i], line);
+                if (i > 0) {
+                    message.append('\n');
+                }
+                message.append(line.c_str());
+            }
+            int httpResponseCode = sendTelegramMessage(message.c_str());
+            if (httpResponseCode == 429) {
+                // Rate limited, not offline: the notifier holds on to them and retries
+                return telegram.retryAfter();
+            }
+            if (httpResponseCode != 200) {
+                logEvents(events, count);
+                if (wifi_connected) {
+                    scheduleSendRetry();
+                }
+            } else {
+                send_retry_ms = 0;
+            }
+            return 0;
+        }
+        case NOTIFY_STATUS: {
+            // A report that cannot be sent is not kept, it would be stale by
+            // the time it got through
+            char timestamp[24];
+            formatEventTime(event.raised_us, timestamp, sizeof(timestamp));
+            int httpResponseCode = sendStatusUpdate(event.state, timestamp);
+            return httpResponseCode == 429 ? telegram.retryAfter() : 0;
+        }
+        case NOTIFY_REPLAY_PENDING: {
+            int httpResponseCode = replayEventLog();
+            if (httpResponseCode == 429) {
+                return telegram.retryAfter();
+            }
+            // One message per delivery keeps the replay within the rate limit
+            if (httpResponseCode == 200) {
+                send_retry_ms = 0;
+                if (eventLog.tail() != eventLog.head()) {
+                    requestReplay();
+                }
+            } else if (httpResponseCode != 0 && wifi_connected && eventLog.tail() != eventLog.head()) {
+                // 0 is nothing to send yet, anything else failed on the way
+                scheduleSendRetry();
             }
-        } else {
-            return "01/01/1001 00:00:00*";
+            return 0;
+        }
+        case NOTIFY_WIFI_CONNECTED: {
+            int httpResponseCode = sendTelegramMessage("connected to WiFi");
+            if (httpResponseCode == 429) {
+                return telegram.retryAfter();
+            }
+            eventLog.flush();
+            if (eventLog.tail() != eventLog.head()) {
+                requestReplay();
+            }
+            return 0;
         }
     }
-
-    char buffer[30];
-    strftime(buffer, sizeof(buffer), "%d/%m/%Y %H:%M:%S", &timeinfo);
-    return String(buffer);
+    return 0;
 }
-void sendTelegramMessage(String message) {
-    if (!wifi_connected) {
-        savePendingMessage(message);
-        return;
-    }
 
-    HTTPClient http;
-    String url = "https://api.telegram.org/bot" + telegramBotToken + "/sendMessage";
-    http.begin(url);
-    http.addHeader("Content-Type", "application/x-www-form-urlencoded");
-    
-    String postData = "chat_id=" + telegramChatId + "&text=" + urlEncode(message);
-    int httpResponseCode = http.POST(postData);
-    
-    if (httpResponseCode != 200) {
-        Serial.printf("Failed to send Telegram message, error code: %d\n", httpResponseCode);
-        savePendingMessage(message);
-    } else {
-        Serial.println("Telegram message sent successfully");
-    }
-    http.end();
+void scheduleSendRetry() {
+    send_retry_ms = send_retry_ms == 0 ? sendRetryFirstMs
+                  : send_retry_ms >= sendRetryMaxMs / 2 ? sendRetryMaxMs : send_retry_ms * 2;
+    send_retry_since = millis();
+    send_retry_scheduled = true;
+    Serial.printf("Replaying the event log in %lu s\n", (unsigned long)(send_retry_ms / 1000));
 }
 
-void savePendingMessage(String message) {
-    // Open the file in FILE_WRITE mode to create it if it doesn’t exist
-    File file = SPIFFS.open(pendingMessagesFile, FILE_APPEND);
-    if (!file) {
-        Serial.println("Failed to open or create pending messages file");
+// Notifier idle hook
+void retryFailedSends() {
+    if (!send_retry_scheduled || millis() - send_retry_since < send_retry_ms) {
         return;
     }
-
-    // Append the message
-    file.println(message);
-    file.close();
-
-    // Trim excess messages if needed
-    trimPendingMessagesFile();
+    send_retry_scheduled = false;
+    // Offline, the link-up replays the log anyway
+    if (wifi_connected) {
+        requestReplay();
+    }
 }
 
-void sendPendingMessages() {
-    if (!wifi_connected || !SPIFFS.exists(pendingMessagesFile)) {
-        return;
+void processSensorChanges() {
+    // One XOR finds every sensor that flipped since the previous sample
+    SensorMask changed = sensor_state ^ prev_sensor_state;
+    while (changed) {
+        const int i = __builtin_ctz(changed);
+        changed &= changed - 1;
+
+        const SensorDescriptor& sensor = sensorTable[i];
+        const bool active = sensor_state & sensorBit(i);
+        if (active ? sensor.onActive : sensor.onInactive) {
+            queueNotification(NOTIFY_SENSOR_CHANGE, i, active);
+        }
     }
 
-    File file = SPIFFS.open(pendingMessagesFile, FILE_READ);
-    if (!file) {
-        Serial.println("Failed to open pending messages file");
-        return;
+    // Check for occupancy changes
+    if ((prev_sensor_state & occupancyMask) && !(sensor_state & occupancyMask)) {
+        queueNotification(NOTIFY_VACANCY);
     }
+}
 
-    // Check if the file is empty
-    if (file.size() == 0) {
-        file.close();  // Close the file if it's empty
-        return;        // Exit the function immediately
+// Local time of an event, the placeholder until the clock has been set
+void formatEventTime(int64_t raised_us, char* buffer, size_t size) {
+    if (!formatTimestamp(raised_us, buffer, size)) {
+        strlcpy(buffer, placeholderTimestamp, size);
     }
+}
 
-    String allMessages; // Buffer for all messages
-
-    // Read the entire file content
-    while (file.available()) {
-        String message = file.readStringUntil('\n');
-        allMessages += message + "\n"; // Append each message to allMessages
+// Returns the HTTP status code. What to keep for later is up to the caller.
+int sendTelegramMessage(const char* message) {
+    if (!wifi_connected) {
+        return HTTPC_ERROR_NOT_CONNECTED;
     }
 
-    file.close(); // Close the file after reading
+    // The text is encoded while it is sent, no encoded copy is built
+    FormBodyStream body(sendMessagePrefix.c_str(), message);
+    int httpResponseCode = telegram.postForm("sendMessage", body);
+    telegram.finish();
 
-    if (allMessages.length() > 0) {
-        sendTelegramMessage(allMessages); // Send all messages at once
+    if (httpResponseCode == 429) {
+        Serial.printf("Telegram rate limit hit, retry after %lu s\n", (unsigned long)telegram.retryAfter());
+    } else if (httpResponseCode != 200) {
+        Serial.printf("Failed to send Telegram message, error code: %d\n", httpResponseCode);
+    } else {
+        Serial.printf("Telegram message sent successfully (%u bytes, %u requests, %u handshakes)\n",
+                      (unsigned)body.size(), telegram.requests(), telegram.handshakes());
     }
-
-    SPIFFS.remove(pendingMessagesFile);
+    return httpResponseCode;
 }
 
-void trimPendingMessagesFile() {
-    // First, count the lines in the file
-    File readFile = SPIFFS.open(pendingMessagesFile, FILE_READ);
-    if (!readFile) {
-        Serial.println("Failed to open file for reading");
-        return;
-    }
+// Limits of the compact form in event_codec.h
+static_assert(NOTIFY_SENSOR_CHANGE == 0 && NOTIFY_VACANCY == 1, "event log stores NotifyEventType in one bit");
+static_assert(sensorCount <= 32, "event log stores the sensor index in five bits");
 
-    // Count lines
-    int lineCount = 0;
-    while (readFile.available()) {
-        if (readFile.read() == '\n') {
-            lineCount++;
+// Keeps the sensor events of a batch that could not be sent in the flash log
+void logEvents(const NotifyEvent* events, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        const NotifyEvent& event = events[i];
+        if (!isCoalescable(event.type)) {
+            continue;
         }
+        StoredTime time = storedTimeAt(event.raised_us);
+        EventRecord record = {};
+        record.time_ms = time.ms;
+        record.timeSession = time.session;
+        record.type = event.type;
+        record.sensor = event.sensor;
+        record.active = event.active;
+        eventLog.append(record);
     }
-    readFile.close();
+}
 
-    // If lines are less than 100, no need to trim
-    if (lineCount < 50) {
-        return;
+// Sends the oldest logged events, as many whole lines as fit one message of
+// telegramMessageLimit characters. The log's cursor only moves past them
+// once Telegram has accepted it, a reboot or a failed send in between sends
+// them again rather than losing them. Returns the HTTP status code, 0 when
+// there was nothing to send.
+int replayEventLog() {
+    // Records stored before the clock was known can only be placed once it is,
+    // loop() asks again when it is set
+    if (!wifi_connected || !timeSynced()) {
+        return 0;
+    }
+
+    // Events staged in RAM only have a position once they are in flash
+    eventLog.flush();
+
+    static ReplayMessage message;
+    message.clear();
+    EventRecord records[16];
+    uint32_t position = eventLog.tail();
+    uint32_t end = position;    // everything before it is in the message, or damaged
+    uint32_t events = 0;
+    bool full = false;
+    while (!full) {
+        size_t count = eventLog.read(position, records, 16);
+        if (count == 0) {
+            end = position;
+            break;
+        }
+        for (size_t i = 0; i < count && !full; i++) {
+            EventLine line;
+            renderRecordLine(records[i], line);
+            if (!message.empty() && message.length() + 1 + line.length() > message.capacity()) {
+                // Split on a record boundary, this one starts the next message
+                end = records[i].sequence;
+                full = true;
+                break;
+            }
+            if (!message.empty()) {
+                message.append('\n');
+            }
+            message.append(line.c_str());
+            events++;
+        }
+        if (!full) {
+            end = position;
+        }
     }
 
-    // Open the file for reading and writing
-    File file = SPIFFS.open(pendingMessagesFile, FILE_READ);
-    if (!file) {
-        Serial.println("Failed to open pending messages file");
-        return;
+    if (events == 0) {
+        // Only damaged records were left, there is nothing to send for them
+        eventLog.release(end);
+        return 0;
     }
 
-    // Read all lines from the file into a String array
-    String lines[50];
-    int lineCount_ = 0;
-
-    while (file.available() && lineCount_ < 50) {
-        lines[lineCount_++] = file.readStringUntil('\n');
+    if (replay_stats.started_us == 0) {
+        replay_stats = {};
+        replay_stats.started_us = monotonicMicros();
     }
-    file.close();
-
-    if (lineCount > 50) {
-        // Re-open the file in FILE_WRITE mode to clear its contents
-        file = SPIFFS.open(pendingMessagesFile, FILE_WRITE);
-        if (!file) {
-            Serial.println("Failed to open pending messages file for writing");
-            return;
-        }
-
-        // Write the newest 90 lines back to the cleared file
-        for (int i = 10; i < lineCount; i++) { // Skip the oldest 10 lines
-            file.println(lines[i]);
-        }
-        file.close();
+    int httpResponseCode = sendTelegramMessage(message.c_str());
+    if (httpResponseCode != 200) {
+        return httpResponseCode;
     }
+    eventLog.release(end);
+    replay_stats.events += events;
+    replay_stats.messages++;
 
-}
-
-void checkStatusCommand() {
-    if (!wifi_connected) {
-        return;
+    if (eventLog.tail() == eventLog.head()) {
+        replay_stats.duration_ms = (uint32_t)((monotonicMicros() - replay_stats.started_us) / 1000);
+        replay_stats.started_us = 0;
+        Serial.printf("Event log drained: %u events in %u messages, %u ms\n",
+                      (unsigned)replay_stats.events, (unsigned)replay_stats.messages,
+                      (unsigned)replay_stats.duration_ms);
     }
+    return httpResponseCode;
+}
 
-    static unsigned long lastProcessedTime = 0;
-
-    HTTPClient http;
-    // Request only new updates
-    String url = "https://api.telegram.org/bot" + telegramBotToken + "/getUpdates?timeout=1";
-    http.begin(url);
-
-    int httpResponseCode = http.GET();
-    if (httpResponseCode == 200) {
-        String response = http.getString();
-
-        // Parse the JSON response
-        DynamicJsonDocument doc(4096);
-        deserializeJson(doc, response);
-
-        for (JsonObject message : doc["result"].as<JsonArray>()) {
-            unsigned long messageTime = message["message"]["date"].as<unsigned long>();
-            String messageText = message["message"]["text"].as<String>();
-
-            // Check if the message is a reply to a bot message
-            if (message.containsKey("message") && message["message"].containsKey("reply_to_message")) {
-                String botMessageText = message["message"]["reply_to_message"]["text"].as<String>();
-
-                // Process commands in replies only if they're new
-                if (messageTime > lastProcessedTime) {
-                    lastProcessedTime = messageTime;
-
-                    // If the reply text is "1" or "status", trigger a status update
-                    if (messageText == "1" || messageText == "status") {
-                        sendStatusUpdate();
-                    }
-                }
-            }
-        }
-    } else {
-        Serial.println("Failed to fetch updates.");
+// Runs on the command task
+void handleCommand(const char* text, bool isReply) {
+    // Only replies to one of the bot's messages count, "1" or "status"
+    // triggers a status update
+    if (isReply && (strcmp(text, "1") == 0 || strcmp(text, "status") == 0)) {
+        status_requested = true;
     }
-    http.end();
 }
 
 
-void sendStatusUpdate() {
-    String statusMessage = "Bharat Multiservices Status:\n\n";
-    statusMessage += "1. WiFi : " + String(wifi_connected ? "Connected" : "Disconnected") + "\n";
-    statusMessage += "2. Shop: " + String(shutter_closed ? "Closed" : "Open") + "\n";
-    statusMessage += "3. Office Door: " + String(office_door_closed ? "Closed" : "Open") + "\n";
-    statusMessage += "4. Drawer: " + String(drawer_closed ? "Closed" : "Open") + "\n";
-    statusMessage += "5. Computer 1: " + String(desk1_occupied ? "Occupied" : "Vacant") + "\n";
-    statusMessage += "6. Computer 2: " + String(desk2_occupied ? "Occupied" : "Vacant") + "\n";
-    statusMessage += "7. Time: " + current_timestamp;
-
-    sendTelegramMessage(statusMessage);
+int sendStatusUpdate(SensorMask state, const char* timestamp) {
+    static TelegramMessage statusMessage;
+    statusMessage.clear();
+    statusMessage.append(statusHeader);
+    statusMessage.appendf(statusWifiLine, wifi_connected ? "Connected" : "Disconnected");
+    for (size_t i = 0; i < sensorCount; i++) {
+        const SensorDescriptor& sensor = sensorTable[i];
+        const char* sensorState = (state & sensorBit(i)) ? sensor.activeState : sensor.inactiveState;
+        statusMessage.appendf(statusSensorLine, (unsigned)(i + 2), sensor.label, sensorState);
+    }
+    statusMessage.appendf(statusTimeLine, (unsigned)(sensorCount + 2), timestamp);
+
+    NotifierStats stats = getNotifierStats();
+    statusMessage.appendf("\n\nQueue: %u waiting, max %u, %u events in %u messages",
+                          (unsigned)stats.depth, (unsigned)stats.maxDepth, (unsigned)stats.delivered, (unsigned)stats.messages);
+    statusMessage.appendf("\nRate limit: %u waits, %u throttled",
+                          (unsigned)stats.rateLimited, (unsigned)stats.throttled);
+
+    WifiStats wifi = getWifiStats();
+    statusMessage.appendf("\nWiFi: %u reconnects, %u attempts (%u failed), last %lu s, max %lu s, offline %lu s total",
+                          (unsigned)wifi.disconnects, (unsigned)wifi.attempts, (unsigned)wifi.failedAttempts,
+                          (unsigned long)(wifi.lastReconnectMs / 1000), (unsigned long)(wifi.maxReconnectMs / 1000),
+                          (unsigned long)(wifi.offlineMs / 1000));
+
+    EventLogStats log = eventLog.stats();
+    statusMessage.appendf("\nEvent log: %u unsent, %u dropped, %u damaged (%u torn sectors)",
+                          (unsigned)log.size, (unsigned)log.dropped, (unsigned)log.corruptEvents,
+                          (unsigned)log.corruptSectors);
+    if (log.appended > 0) {
+        // Tenths of a byte, like the replay rate below
+        uint32_t perEvent = (uint32_t)((uint64_t)log.appendedBytes * 10 / log.appended);
+        statusMessage.appendf(", %u.%u bytes/event", (unsigned)(perEvent / 10), (unsigned)(perEvent % 10));
+    }
+    if (replay_stats.duration_ms > 0) {
+        // Tenths of an event per second, without pulling in float formatting
+        uint32_t rate = (uint32_t)((uint64_t)replay_stats.events * 10000 / replay_stats.duration_ms);
+        statusMessage.appendf("\nLast replay: %u events in %u messages, %u.%u events/s",
+                              (unsigned)replay_stats.events, (unsigned)replay_stats.messages,
+                              (unsigned)(rate / 10), (unsigned)(rate % 10));
+    }
+
+    TimeServiceStats clock = getTimeServiceStats();
+    statusMessage.appendf("\nTime: %u syncs, last %lu s ago, corrected by %ld ms",
+                          (unsigned)clock.syncs, (unsigned long)clock.lastSyncAge_s, (long)clock.lastCorrection_ms);
+    if (stats.delivered > 0) {
+        statusMessage.appendf("\nLatency: avg %lu ms, max %lu ms",
+                              (unsigned long)(stats.totalLatency_us / stats.delivered / 1000),
+                              (unsigned long)(stats.maxLatency_us / 1000));
+    }
+#if ALLOC_COUNTER
+    statusMessage.appendf("\nEvent path allocations: %u", (unsigned)event_path_allocations);
+#endif
+#if LOOP_PROFILER
+    // Where loop() spends its time, the period is the gap between two sensor reads
+    statusMessage.append("\n\nLoop, avg / p99 / max us:");
+    for (uint8_t i = 0; i <= LOOP_PERIOD; i++) {
+        LoopStageStats stage = getLoopStageStats((LoopStage)i);
+        statusMessage.appendf("\n%s: %lu / %lu / %lu", loopStageName((LoopStage)i), (unsigned long)stage.mean_us,
+                              (unsigned long)stage.p99_us, (unsigned long)stage.max_us);
+    }
+#endif
+
+    return sendTelegramMessage(statusMessage.c_str());
 }
-
-String urlEncode(String str) {
-    String encodedString = "";
-    char c;
-    char code0;
-    char code1;
-
-    for (int i = 0; i < str.length(); i++) {
-        c = str.charAt(i);
-        if (isalnum(c)) {
-            encodedString += c;
-        } else if (c == ' ') {
-            encodedString += '+';
-        } else {
-            code1 = (c & 0xf) + '0';
-            if ((c & 0xf) > 9) {
-                code1 = (c & 0xf) - 10 + 'A';
-            }
-            c = (c >> 4) & 0xf;
-            code0 = c + '0';
-            if (c > 9) {
-                code0 = c - 10 + 'A';
-            }
-            encodedString += '%';
-            encodedString += code0;
-            encodedString += code1;
-        }
-    }
-    
-    return encodedString;
-}
\ No newline at end of file
@@ -0,0 +1,273 @@
+#include <Arduino.h>
+#include <limits.h>
+#include <atomic>
+#include "notifier.h"
+#include "token_bucket.h"
+
+static QueueHandle_t notifyQueue = nullptr;
+static NotifyDeliverFn deliverEvents = nullptr;
+static NotifyIdleFn idleHook = nullptr;
+static uint32_t idleInterval = 0;
+
+// Events waiting for their turn, in arrival order. Only touched by the notifier task.
+static NotifyEvent pending[NOTIFY_PENDING_CAPACITY];
+static size_t pendingCount = 0;
+
+// One message worth of events handed to deliver()
+static NotifyEvent batch[NOTIFY_MAX_BATCH];
+static size_t batchPending[NOTIFY_MAX_BATCH];   // where each batch entry sits in pending[]
+
+static TokenBucket sendBudget(NOTIFY_RATE_BURST, NOTIFY_RATE_INTERVAL_MS);
+
+// Delivery figures are written by the notifier task, enqueued / dropped /
+// maxDepth by notify() from either task, all of them under statsLock
+static NotifierStats stats = {};
+static portMUX_TYPE statsLock = portMUX_INITIALIZER_UNLOCKED;
+
+// A requestReplay() that found the queue full, picked up by the notifier task
+static std::atomic<bool> replayRequested(false);
+
+static NotifyEvent replayEvent() {
+    NotifyEvent event = {};
+    event.type = NOTIFY_REPLAY_PENDING;
+    event.priority = SENSOR_PRIORITY_NORMAL;
+    event.enqueued_us = micros();
+    return event;
+}
+
+// Drops the delivered entries (marked in taken[]) from pending[], keeping the order
+static void removePending(const bool* taken) {
+    size_t kept = 0;
+    for (size_t i = 0; i < pendingCount; i++) {
+        if (!taken[i]) {
+            pending[kept++] = pending[i];
+        }
+    }
+    pendingCount = kept;
+}
+
+// Highest priority first, the oldest among equals
+static int nextPending() {
+    int best = -1;
+    for (size_t i = 0; i < pendingCount; i++) {
+        if (best < 0 || pending[i].priority > pending[best].priority) {
+            best = (int)i;
+        }
+    }
+    return best;
+}
+
+// Whether a message should go out now, rate limit aside
+static bool messageDue(uint32_t now_us) {
+    size_t coalescable = 0;
+    for (size_t i = 0; i < pendingCount; i++) {
+        const NotifyEvent& event = pending[i];
+        if (!isCoalescable(event.type) || event.priority >= NOTIFY_BYPASS_PRIORITY) {
+            return true;
+        }
+        // The coalescing window opens when an event is raised
+        if (now_us - event.enqueued_us >= NOTIFY_COALESCE_WINDOW_MS * 1000UL) {
+            return true;
+        }
+        coalescable++;
+    }
+    return coalescable >= NOTIFY_MAX_BATCH;
+}
+
+// Milliseconds until the oldest coalescable event's window closes
+static unsigned long windowRemaining(uint32_t now_us) {
+    unsigned long wait = NOTIFY_COALESCE_WINDOW_MS;
+    for (size_t i = 0; i < pendingCount; i++) {
+        unsigned long age = (now_us - pending[i].enqueued_us) / 1000;
+        unsigned long left = age >= NOTIFY_COALESCE_WINDOW_MS ? 0 : NOTIFY_COALESCE_WINDOW_MS - age;
+        wait = min(wait, left);
+    }
+    return wait;
+}
+
+// Fills batch[] with the next message: the top event on its own when it
+// cannot be coalesced, otherwise every coalescable event, by priority
+static size_t takeBatch() {
+    int top = nextPending();
+    if (!isCoalescable(pending[top].type)) {
+        batch[0] = pending[top];
+        batchPending[0] = top;
+        return 1;
+    }
+
+    size_t count = 0;
+    for (int priority = pending[top].priority; priority >= 0 && count < NOTIFY_MAX_BATCH; priority--) {
+        for (size_t i = 0; i < pendingCount && count < NOTIFY_MAX_BATCH; i++) {
+            if (pending[i].priority == priority && isCoalescable(pending[i].type)) {
+                batch[count] = pending[i];
+                batchPending[count++] = i;
+            }
+        }
+    }
+    return count;
+}
+
+static void deliverNext() {
+    size_t count = takeBatch();
+    sendBudget.take(millis());
+
+    uint32_t retryAfter = deliverEvents(batch, count);
+    if (retryAfter > 0) {
+        // Everything stays pending, nothing goes out until the server is ready again
+        portENTER_CRITICAL(&statsLock);
+        stats.throttled++;
+        portEXIT_CRITICAL(&statsLock);
+        sendBudget.pause(millis(), retryAfter * 1000UL);
+        Serial.printf("Notifier: throttled by the server, retrying in %lu s\n", (unsigned long)retryAfter);
+        return;
+    }
+
+    bool taken[NOTIFY_PENDING_CAPACITY] = {};
+    uint32_t now = micros();
+    portENTER_CRITICAL(&statsLock);
+    stats.messages++;
+    for (size_t i = 0; i < count; i++) {
+        taken[batchPending[i]] = true;
+        uint32_t latency = now - batch[i].enqueued_us;
+        stats.delivered++;
+        stats.lastLatency_us = latency;
+        stats.totalLatency_us += latency;
+        if (latency > stats.maxLatency_us) {
+            stats.maxLatency_us = latency;
+        }
+    }
+    portEXIT_CRITICAL(&statsLock);
+    removePending(taken);
+
+    Serial.printf("Notifier: %u event(s) delivered in one message, %u pending, %u queued\n",
+                  (unsigned)count, (unsigned)pendingCount, (unsigned)uxQueueMessagesWaiting(notifyQueue));
+}
+
+static unsigned long remaining(unsigned long interval, unsigned long since) {
+    unsigned long elapsed = millis() - since;
+    return elapsed >= interval ? 0 : interval - elapsed;
+}
+
+static void notifierTask(void* arg) {
+    (void)arg;
+    unsigned long lastIdle = millis();
+    bool waitingForBudget = false;
+
+    for (;;) {
+        if (pendingCount < NOTIFY_PENDING_CAPACITY && replayRequested.exchange(false)) {
+            pending[pendingCount++] = replayEvent();
+            portENTER_CRITICAL(&statsLock);
+            stats.enqueued++;
+            portEXIT_CRITICAL(&statsLock);
+        }
+
+        // Send what is due, as far as the rate limit allows
+        unsigned long wait = ULONG_MAX;
+        if (pendingCount > 0) {
+            if (messageDue(micros())) {
+                uint32_t budgetWait = sendBudget.wait(millis());
+                if (budgetWait == 0) {
+                    waitingForBudget = false;
+                    deliverNext();
+                    continue;
+                }
+                if (!waitingForBudget) {
+                    portENTER_CRITICAL(&statsLock);
+                    stats.rateLimited++;
+                    portEXIT_CRITICAL(&statsLock);
+                    waitingForBudget = true;
+                }
+                wait = budgetWait;
+            } else {
+                wait = windowRemaining(micros());
+            }
+        }
+        if (idleHook) {
+            wait = min(wait, remaining(idleInterval, lastIdle));
+        }
+
+        // Sleep until the next event or whatever is due first. Everything
+        // already queued is pulled in, so priorities apply across all of it.
+        TickType_t ticks = portMAX_DELAY;
+        if (wait != ULONG_MAX) {
+            ticks = wait == 0 ? 0 : max((TickType_t)pdMS_TO_TICKS(wait), (TickType_t)1);
+        }
+        if (pendingCount < NOTIFY_PENDING_CAPACITY) {
+            while (pendingCount < NOTIFY_PENDING_CAPACITY
+                   && xQueueReceive(notifyQueue, &pending[pendingCount], ticks) == pdTRUE) {
+                pendingCount++;
+                ticks = 0;
+            }
+        } else {
+            vTaskDelay(max(ticks, (TickType_t)1));
+        }
+
+        if (idleHook && remaining(idleInterval, lastIdle) == 0) {
+            idleHook();
+            lastIdle = millis();
+        }
+    }
+}
+
+bool startNotifier(NotifyDeliverFn deliver, NotifyIdleFn idle, uint32_t idleIntervalMs) {
+    deliverEvents = deliver;
+    idleHook = idle;
+    idleInterval = idleIntervalMs;
+
+    notifyQueue = xQueueCreate(NOTIFIER_QUEUE_LENGTH, sizeof(NotifyEvent));
+    if (!notifyQueue) {
+        Serial.println("Failed to create notifier queue");
+        return false;
+    }
+
+    // TLS handshakes need a generous stack
+    if (xTaskCreatePinnedToCore(notifierTask, "notifier", 12288, nullptr, 1, nullptr, NOTIFIER_CORE) != pdPASS) {
+        Serial.println("Failed to start notifier task");
+        return false;
+    }
+    return true;
+}
+
+static bool enqueue(NotifyEvent& event) {
+    event.enqueued_us = micros();
+    if (!notifyQueue || xQueueSend(notifyQueue, &event, 0) != pdTRUE) {
+        return false;
+    }
+
+    uint32_t depth = uxQueueMessagesWaiting(notifyQueue);
+    portENTER_CRITICAL(&statsLock);
+    stats.enqueued++;
+    if (depth > stats.maxDepth) {
+        stats.maxDepth = depth;
+    }
+    portEXIT_CRITICAL(&statsLock);
+    return true;
+}
+
+bool notify(NotifyEvent& event) {
+    if (!enqueue(event)) {
+        portENTER_CRITICAL(&statsLock);
+        stats.dropped++;
+        portEXIT_CRITICAL(&statsLock);
+        return false;
+    }
+    return true;
+}
+
+void requestReplay() {
+    NotifyEvent event = replayEvent();
+    if (!enqueue(event)) {
+        // The notifier task has a full queue to work through, it sees the
+        // flag before it next waits
+        replayRequested.store(true);
+    }
+}
+
+NotifierStats getNotifierStats() {
+    uint32_t depth = (notifyQueue ? uxQueueMessagesWaiting(notifyQueue) : 0) + pendingCount;
+    portENTER_CRITICAL(&statsLock);
+    NotifierStats snapshot = stats;
+    portEXIT_CRITICAL(&statsLock);
+    snapshot.depth = depth;
+    return snapshot;
+}
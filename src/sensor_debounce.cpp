@@ -0,0 +1,92 @@
+#include "sensor_debounce.h"
+
+void SensorDebouncer::reset(SensorMask raw, uint32_t now_us) {
+    stable_ = raw;
+    raw_ = raw;
+    pending_ = 0;
+    lastUpdate_us_ = now_us;
+    for (size_t i = 0; i < sensorCount; i++) {
+        pendingSince_[i] = now_us;
+        stableSince_[i] = now_us;
+    }
+}
+
+bool SensorDebouncer::settled(size_t i, uint32_t now_us, uint32_t* due_us) const {
+    const SensorDescriptor& sensor = sensorTable[i];
+    const bool toActive = !(stable_ & sensorBit(i));
+    const uint32_t settle_us = (uint32_t)(toActive ? sensor.settleActiveMs : sensor.settleInactiveMs) * 1000;
+    const uint32_t pending_us = now_us - pendingSince_[i];
+    if (pending_us < settle_us) {
+        return false;
+    }
+    // How long ago the change became acceptable
+    uint32_t slack_us = pending_us - settle_us;
+    if (!toActive) {
+        const uint32_t minActive_us = (uint32_t)sensor.minActiveMs * 1000;
+        const uint32_t active_us = now_us - stableSince_[i];
+        if (active_us < minActive_us) {
+            return false;
+        }
+        if (active_us - minActive_us < slack_us) {
+            slack_us = active_us - minActive_us;
+        }
+    }
+    *due_us = now_us - slack_us;
+    return true;
+}
+
+SensorMask SensorDebouncer::update(SensorMask raw, uint32_t now_us) {
+    return apply(raw, now_us, now_us);
+}
+
+SensorMask SensorDebouncer::sample(SensorMask raw, uint32_t now_us) {
+    return apply(raw, now_us, lastUpdate_us_);
+}
+
+SensorMask SensorDebouncer::apply(SensorMask raw, uint32_t now_us, uint32_t held_us) {
+    raw_ = raw;
+    lastUpdate_us_ = now_us;
+
+    // Sensors that went back to their stable state drop their candidate,
+    // unless it had already held long enough by held_us. Then the change
+    // counts, and the way back settles as a change of its own, from the next
+    // call on.
+    SensorMask reverted = pending_ & ~(raw ^ stable_);
+    SensorMask committed = 0;
+    while (reverted) {
+        const int i = __builtin_ctz(reverted);
+        reverted &= reverted - 1;
+        uint32_t due_us;
+        if (settled(i, held_us, &due_us)) {
+            stable_ ^= sensorBit(i);
+            stableSince_[i] = due_us;
+            committed |= sensorBit(i);
+        }
+        pending_ &= ~sensorBit(i);
+    }
+
+    // Sensors that just started to differ begin settling now
+    const SensorMask differs = raw ^ stable_;
+    SensorMask fresh = differs & ~pending_;
+    while (fresh) {
+        const int i = __builtin_ctz(fresh);
+        fresh &= fresh - 1;
+        pendingSince_[i] = now_us;
+        pending_ |= sensorBit(i);
+    }
+
+    // A sensor changes at most once per call, so the caller sees every edge
+    SensorMask settling = pending_ & ~committed;
+    while (settling) {
+        const int i = __builtin_ctz(settling);
+        settling &= settling - 1;
+        uint32_t due_us;
+        if (settled(i, now_us, &due_us)) {
+            stable_ ^= sensorBit(i);
+            stableSince_[i] = due_us;
+            pending_ &= ~sensorBit(i);
+        }
+    }
+
+    return stable_;
+}
@@ -0,0 +1,69 @@
+#include <Arduino.h>
+#include "sensor_sampler.h"
+
+#if SENSOR_SAMPLER_GPIO_REGISTER
+#include "soc/soc.h"
+#include "soc/gpio_reg.h"
+#endif
+
+namespace {
+
+constexpr bool anyPinAbove31From(size_t index) {
+    return index < sensorCount && (sensorTable[index].pin > 31 || anyPinAbove31From(index + 1));
+}
+
+// GPIO32..39 live in a second input register, only read it when a sensor needs it
+constexpr bool needsHighInputRegister = anyPinAbove31From(0);
+
+// sensorTable is in flash, which is out of reach while the cache is off for
+// a flash write, so the ISR-safe sampler reads its pins from a copy in DRAM,
+// filled in at compile time
+template <size_t... I> struct IndexList {};
+template <size_t N, size_t... I> struct MakeIndexList : MakeIndexList<N - 1, N - 1, I...> {};
+template <size_t... I> struct MakeIndexList<0, I...> { typedef IndexList<I...> type; };
+
+struct SensorPins {
+    uint8_t pin[sensorCount];
+};
+
+template <size_t... I>
+constexpr SensorPins sensorPinsFrom(IndexList<I...>) {
+    return SensorPins{ { sensorTable[I].pin... } };
+}
+
+DRAM_ATTR const SensorPins sensorPins = sensorPinsFrom(MakeIndexList<sensorCount>::type());
+
+}  // namespace
+
+#if SENSOR_SAMPLER_GPIO_REGISTER
+
+SensorMask IRAM_ATTR sampleSensorInputs() {
+    // One load captures every pin on GPIO0..31 in the same instant, so
+    // sensors that change together are always seen together
+    uint64_t levels = REG_READ(GPIO_IN_REG);
+    if (needsHighInputRegister) {
+        levels |= (uint64_t)(REG_READ(GPIO_IN1_REG) & GPIO_IN1_DATA) << 32;
+    }
+
+    SensorMask state = 0;
+    for (size_t i = 0; i < sensorCount; i++) {
+        if (levels & ((uint64_t)1 << sensorPins.pin[i])) {
+            state |= sensorBit(i);
+        }
+    }
+    return state ^ activeLowMask;
+}
+
+#else
+
+SensorMask IRAM_ATTR sampleSensorInputs() {
+    SensorMask state = 0;
+    for (size_t i = 0; i < sensorCount; i++) {
+        if (digitalRead(sensorPins.pin[i]) == HIGH) {
+            state |= sensorBit(i);
+        }
+    }
+    return state ^ activeLowMask;
+}
+
+#endif
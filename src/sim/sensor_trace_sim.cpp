@@ -0,0 +1,815 @@
+// Replays a day of sensor pin traces through the unchanged firmware on a
+// simulated clock, to tune debounce, coalescing and rate limit settings
+// without waiting for the shop to open.
+//
+// main.cpp runs as it does on the board: setup(), then loop() until the end
+// of the day, with the notifier, command, WiFi and SNTP tasks alongside, all
+// on the VirtualClock of lib/native_hal. A player task drives the pins and
+// the access point at the exact instants of the trace; GPIO interrupts,
+// readSensorStates() and processSensorChanges() take it from there. A day
+// takes a few seconds and the same trace always gives the same result.
+//
+// Every sendMessage reaching the fake Telegram API and every write and erase
+// of the event log partition is captured. The run is checked against a
+// reference model of the debouncer, which says which notifications the
+// trace must produce and when, and the report shows:
+//
+//   - notifications per hour of the day, with the flash writes behind them
+//   - missed transitions (expected, never delivered) and unexpected lines
+//   - detection latency from the pin edge to Telegram, mean and worst, and
+//     the worst among events that saw no WiFi outage
+//   - the event log's flash traffic
+//
+// Trace format, one change per line, '#' starts a comment:
+//
+//   <seconds since local midnight> <pin> <0|1>      pin level
+//   <seconds since local midnight> wifi <0|1>       access point in range
+//
+// Lines at or before the boot time set the levels the day starts with; pins
+// without one start inactive. Without --trace a synthetic shop day is
+// generated from --seed.
+//
+//   pio run -e sensor_sim -t exec
+//   .pio/build/sensor_sim/program --seed 7 --write-trace day.txt
+//   .pio/build/sensor_sim/program --trace day.txt --from 08:00 --to 21:30 --strict
+//
+// Options: --from / --to HH:MM (boot and end of the day, 07:30 and 22:30),
+// --latency MS (Telegram response time, 200), --dump (list every captured
+// message and flash operation), --serial (show the firmware's Serial output),
+// --strict (exit with 1 when a transition is missed or a line unexpected).
+// Build with -DSENSOR_EDGE_CAPTURE=0 to simulate the polling loop instead of
+// the edge interrupts. The reference model stays in continuous time, so that
+// build reports as missed the short changes a 100 ms poll cannot see, and
+// --strict is only meant for the edge build.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <Arduino.h>
+#include "esp_partition.h"
+#include "native_hal.h"
+#include "virtual_clock.h"
+#include "sensors.h"
+#include "event_log.h"
+
+extern EventLog eventLog;
+
+namespace {
+
+// Local time of main.cpp's gmtOffset_sec, messages are stamped with it
+const long localOffsetSec = 19800;
+// The simulated day, a Monday
+const int dayYear = 2025, dayMonth = 3, dayOfMonth = 3;
+
+// Stamp of events raised before the clock was set, as in main.cpp
+const char* const placeholderPrefix = "01/01/1001";
+
+const int wifiPin = -1;
+
+struct TraceStep {
+    int64_t time_us;        // since local midnight
+    int pin;                // wifiPin for the access point
+    int level;
+};
+
+struct ExpectedEvent {
+    int64_t edge_us;        // raw edge that started the change, since boot
+    int64_t stable_us;      // when the debouncer has to accept it
+    int key;                // index into the templates, see templateKey()
+    bool matched;
+    int64_t delivered_us;
+};
+
+struct DeliveredLine {
+    int64_t time_us;
+    int key;                // -1 = not a sensor notification
+    int stampSecond;        // local second of day in the stamp, -1 = placeholder
+    std::string text;
+};
+
+struct Options {
+    const char* tracePath = nullptr;
+    const char* writeTracePath = nullptr;
+    uint32_t seed = 1;
+    int64_t from_us = (7 * 3600 + 30 * 60) * 1000000LL;
+    int64_t to_us = (22 * 3600 + 30 * 60) * 1000000LL;
+    int64_t latency_us = 200000;
+    bool dump = false;
+    bool serial = false;
+    bool strict = false;
+};
+
+uint32_t rngState = 1;
+
+uint32_t nextRandom() {
+    rngState = rngState * 1103515245 + 12345;
+    return rngState >> 8;
+}
+
+// Uniform in [low, high] milliseconds, returned in us
+int64_t randomMillis(uint32_t low, uint32_t high) {
+    return (int64_t)(low + nextRandom() % (high - low + 1)) * 1000;
+}
+
+int64_t clockTime(int hours, int minutes) {
+    return ((int64_t)hours * 3600 + minutes * 60) * 1000000;
+}
+
+// "HH:MM:SS.mmm" of a time since local midnight
+const char* formatDayTime(int64_t us, char* buffer, size_t size) {
+    int64_t ms = us / 1000;
+    snprintf(buffer, size, "%02d:%02d:%02d.%03d", (int)(ms / 3600000), (int)(ms / 60000 % 60),
+             (int)(ms / 1000 % 60), (int)(ms % 1000));
+    return buffer;
+}
+
+bool parseDayTime(const char* text, int64_t* us) {
+    int hours, minutes;
+    if (sscanf(text, "%d:%d", &hours, &minutes) != 2 || hours < 0 || hours > 24 || minutes < 0 || minutes > 59) {
+        return false;
+    }
+    *us = clockTime(hours, minutes);
+    return true;
+}
+
+int sensorOfPin(int pin) {
+    for (size_t i = 0; i < sensorCount; i++) {
+        if (sensorTable[i].pin == pin) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+int inactiveLevel(size_t sensor) {
+    return sensorTable[sensor].activeLow ? HIGH : LOW;
+}
+
+// --- synthetic day ---
+
+// Drives one pin through its own list of changes, with contact bounce
+class PinScript {
+public:
+    PinScript(std::vector<TraceStep>& steps, int pin, int level) : steps_(steps), pin_(pin), level_(level) {
+        steps_.push_back(TraceStep{ 0, pin, level });
+    }
+
+    void set(int64_t at, int level) {
+        if (level != level_) {
+            steps_.push_back(TraceStep{ at, pin_, level });
+            level_ = level;
+        }
+    }
+
+    // A reed contact chatters for a few ms before it settles on level
+    void bounce(int64_t at, int level) {
+        int chatter = nextRandom() % 4;
+        int64_t t = at;
+        for (int i = 0; i < chatter; i++) {
+            set(t, level);
+            t += randomMillis(0, 2) + 200;
+            set(t, !level);
+            t += randomMillis(0, 2) + 200;
+        }
+        set(t, level);
+    }
+
+    // Spike shorter than any settle time, must not produce a notification
+    void glitch(int64_t at) {
+        int level = level_;
+        set(at, !level);
+        set(at + randomMillis(1, 8), level);
+    }
+
+private:
+    std::vector<TraceStep>& steps_;
+    int pin_;
+    int level_;
+};
+
+// Closed contact = LOW on the activeLow pins
+int contactLevel(size_t sensor, bool active) {
+    return active == sensorTable[sensor].activeLow ? LOW : HIGH;
+}
+
+// Someone opening something now and then, each time for a while
+void addOpenings(PinScript& pin, size_t sensor, int64_t start, int64_t end,
+                 uint32_t minGap_ms, uint32_t maxGap_ms, uint32_t minOpen_ms, uint32_t maxOpen_ms) {
+    int64_t t = start + randomMillis(minGap_ms, maxGap_ms);
+    while (t < end) {
+        pin.bounce(t, contactLevel(sensor, false));
+        t += randomMillis(minOpen_ms, maxOpen_ms);
+        pin.bounce(t, contactLevel(sensor, true));
+        if (nextRandom() % 5 == 0) {
+            pin.glitch(t + randomMillis(1000, 60000));
+        }
+        t += randomMillis(minGap_ms, maxGap_ms);
+    }
+}
+
+// PIR output while someone sits at the desk: motion keeps retriggering it,
+// mostly with short quiet spells, now and then a longer one
+void addPresence(PinScript& pin, int64_t start, int64_t end) {
+    int64_t t = start;
+    while (t < end) {
+        pin.set(t, HIGH);
+        t += randomMillis(2000, 8000);
+        pin.set(t, LOW);
+        t += nextRandom() % 10 == 0 ? randomMillis(3000, 20000) : randomMillis(300, 2500);
+    }
+    pin.set(t, LOW);
+}
+
+// Shutter up at nine and down at nine, doors, the drawer, two desks with a
+// lunch break and a few coffee breaks, and a WiFi outage in the afternoon
+std::vector<TraceStep> syntheticDay(uint32_t seed) {
+    rngState = seed;
+    std::vector<TraceStep> steps;
+    PinScript shop(steps, sensorTable[0].pin, contactLevel(0, true));
+    PinScript door(steps, sensorTable[1].pin, contactLevel(1, true));
+    PinScript drawer(steps, sensorTable[2].pin, contactLevel(2, true));
+    PinScript desk1(steps, sensorTable[3].pin, LOW);
+    PinScript desk2(steps, sensorTable[4].pin, LOW);
+
+    int64_t open = clockTime(9, 0) + randomMillis(0, 600000);
+    int64_t close = clockTime(21, 0) + randomMillis(0, 900000);
+    shop.bounce(open, contactLevel(0, false));
+    shop.bounce(close, contactLevel(0, true));
+
+    addOpenings(door, 1, open, close, 600000, 3600000, 5000, 120000);
+    addOpenings(drawer, 2, open, close, 300000, 2700000, 3000, 40000);
+
+    int64_t lunch = clockTime(13, 0) + randomMillis(0, 1800000);
+    int64_t arrive1 = open + randomMillis(60000, 900000);
+    addPresence(desk1, arrive1, lunch);
+    addPresence(desk1, lunch + randomMillis(2400000, 3600000), close - randomMillis(60000, 600000));
+
+    // The second desk is taken in spells of up to an hour
+    int64_t t = open + randomMillis(1800000, 3600000);
+    while (t < close - 3600000) {
+        int64_t leave = t + randomMillis(600000, 3600000);
+        addPresence(desk2, t, leave);
+        t = leave + randomMillis(600000, 5400000);
+    }
+
+    int64_t outage = clockTime(14, 30) + randomMillis(0, 3600000);
+    steps.push_back(TraceStep{ outage, wifiPin, 0 });
+    steps.push_back(TraceStep{ outage + randomMillis(120000, 900000), wifiPin, 1 });
+
+    std::stable_sort(steps.begin(), steps.end(), [](const TraceStep& a, const TraceStep& b) {
+        return a.time_us < b.time_us;
+    });
+    return steps;
+}
+
+// --- trace files ---
+
+bool readTrace(const char* path, std::vector<TraceStep>& steps) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return false;
+    }
+    char line[128];
+    int number = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), file)) {
+        number++;
+        char* comment = strchr(line, '#');
+        if (comment) {
+            *comment = '\0';
+        }
+        double seconds;
+        char what[16];
+        int level;
+        int fields = sscanf(line, "%lf %15s %d", &seconds, what, &level);
+        if (fields <= 0) {
+            continue;
+        }
+        TraceStep step;
+        step.time_us = (int64_t)(seconds * 1000000 + 0.5);
+        step.level = level ? 1 : 0;
+        step.pin = strcmp(what, "wifi") == 0 ? wifiPin : atoi(what);
+        if (fields != 3 || (step.pin != wifiPin && sensorOfPin(step.pin) < 0)) {
+            fprintf(stderr, "%s:%d: expected <seconds> <sensor pin|wifi> <0|1>\n", path, number);
+            ok = false;
+        }
+        steps.push_back(step);
+    }
+    fclose(file);
+    std::stable_sort(steps.begin(), steps.end(), [](const TraceStep& a, const TraceStep& b) {
+        return a.time_us < b.time_us;
+    });
+    return ok;
+}
+
+bool writeTrace(const char* path, const std::vector<TraceStep>& steps, uint32_t seed) {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "cannot write %s\n", path);
+        return false;
+    }
+    fprintf(file, "# synthetic shop day, seed %u\n# seconds since local midnight, sensor pin or wifi, level\n",
+            (unsigned)seed);
+    for (const TraceStep& step : steps) {
+        char when[16];
+        fprintf(file, "%.6f ", step.time_us / 1e6);
+        if (step.pin == wifiPin) {
+            fprintf(file, "wifi %d", step.level);
+        } else {
+            fprintf(file, "%d %d", step.pin, step.level);
+        }
+        fprintf(file, "    # %s %s\n", formatDayTime(step.time_us, when, sizeof(when)),
+                step.pin == wifiPin ? "access point" : sensorTable[sensorOfPin(step.pin)].label);
+    }
+    return fclose(file) == 0;
+}
+
+// --- reference model ---
+
+// Sensor notifications come first, one key per sensor and direction, the
+// vacancy message last
+int sensorKey(size_t sensor, bool active) {
+    return (int)(sensor * 2 + (active ? 1 : 0));
+}
+
+const int vacancyKey = (int)(sensorCount * 2);
+const int keyCount = vacancyKey + 1;
+
+const char* keyTemplate(int key) {
+    if (key == vacancyKey) {
+        return vacancyMessage;
+    }
+    const SensorDescriptor& sensor = sensorTable[key / 2];
+    return key % 2 ? sensor.onActive : sensor.onInactive;
+}
+
+// "Drawer Open", "Computer 1 Occupied", "vacancy"
+std::string keyName(int key) {
+    if (key == vacancyKey) {
+        return "vacancy";
+    }
+    const SensorDescriptor& sensor = sensorTable[key / 2];
+    return std::string(sensor.label) + " " + (key % 2 ? sensor.activeState : sensor.inactiveState);
+}
+
+// Which notification a delivered line is, by the template text before %s
+int templateKey(const std::string& line) {
+    for (int key = 0; key < keyCount; key++) {
+        const char* messageTemplate = keyTemplate(key);
+        if (!messageTemplate) {
+            continue;
+        }
+        size_t prefix = strstr(messageTemplate, "%s") - messageTemplate;
+        if (line.size() > prefix && line.compare(0, prefix, messageTemplate, prefix) == 0) {
+            return key;
+        }
+    }
+    return -1;
+}
+
+struct StableChange {
+    int64_t edge_us;
+    int64_t stable_us;
+    size_t sensor;
+    bool active;
+};
+
+// What SensorDebouncer makes of one sensor's raw edges in continuous time:
+// a change counts once the raw level has held for the settle time of its
+// direction, and an active sensor is held for its minimum active time. A
+// change due by the time of the next edge counts, even though that edge
+// takes it back.
+void debounceSensor(size_t sensor, bool initial, const std::vector<std::pair<int64_t, bool>>& edges,
+                    int64_t end_us, std::vector<StableChange>& changes) {
+    const SensorDescriptor& descriptor = sensorTable[sensor];
+    bool stable = initial;
+    bool raw = initial;
+    int64_t stableSince = 0;
+    int64_t pendingSince = -1;
+
+    size_t next = 0;
+    for (;;) {
+        int64_t nextEdge = next < edges.size() ? edges[next].first : end_us;
+        if (pendingSince >= 0) {
+            int64_t due = pendingSince + (int64_t)(raw ? descriptor.settleActiveMs : descriptor.settleInactiveMs) * 1000;
+            if (!raw) {
+                due = std::max(due, stableSince + (int64_t)descriptor.minActiveMs * 1000);
+            }
+            if (due <= nextEdge) {
+                changes.push_back(StableChange{ pendingSince, due, sensor, raw });
+                stable = raw;
+                stableSince = due;
+                pendingSince = -1;
+            }
+        }
+        if (next == edges.size()) {
+            break;
+        }
+        raw = edges[next].second;
+        int64_t at = edges[next].first;
+        next++;
+        if (raw == stable) {
+            pendingSince = -1;
+        } else if (pendingSince < 0) {
+            pendingSince = at;
+        }
+    }
+}
+
+// Notifications the trace has to produce, on the boot clock
+std::vector<ExpectedEvent> expectedEvents(const std::vector<TraceStep>& steps, const SensorMask initial,
+                                          int64_t from_us, int64_t end_us) {
+    std::vector<StableChange> changes;
+    for (size_t i = 0; i < sensorCount; i++) {
+        std::vector<std::pair<int64_t, bool>> edges;
+        bool level = initial & sensorBit(i);
+        for (const TraceStep& step : steps) {
+            if (step.time_us > from_us && step.pin == sensorTable[i].pin) {
+                bool active = (step.level == HIGH) != sensorTable[i].activeLow;
+                if (active != level) {
+                    edges.push_back(std::make_pair(step.time_us - from_us, active));
+                    level = active;
+                }
+            }
+        }
+        debounceSensor(i, initial & sensorBit(i), edges, end_us, changes);
+    }
+    std::stable_sort(changes.begin(), changes.end(), [](const StableChange& a, const StableChange& b) {
+        return a.stable_us < b.stable_us;
+    });
+
+    std::vector<ExpectedEvent> expected;
+    SensorMask state = initial;
+    for (const StableChange& change : changes) {
+        SensorMask before = state;
+        state ^= sensorBit(change.sensor);
+        const SensorDescriptor& sensor = sensorTable[change.sensor];
+        if (change.active ? sensor.onActive : sensor.onInactive) {
+            expected.push_back(ExpectedEvent{ change.edge_us, change.stable_us,
+                                              sensorKey(change.sensor, change.active), false, 0 });
+        }
+        if ((before & occupancyMask) && !(state & occupancyMask)) {
+            expected.push_back(ExpectedEvent{ change.edge_us, change.stable_us, vacancyKey, false, 0 });
+        }
+    }
+    return expected;
+}
+
+// Second of the local day in a "dd/mm/yyyy hh:mm:ss" stamp at the end of a
+// line, -1 for the placeholder or no stamp
+int stampSecond(const std::string& line) {
+    size_t at = line.rfind(" at ");
+    if (at == std::string::npos || line.compare(at + 4, strlen(placeholderPrefix), placeholderPrefix) == 0) {
+        return -1;
+    }
+    int day, month, year, hours, minutes, seconds;
+    if (sscanf(line.c_str() + at + 4, "%d/%d/%d %d:%d:%d", &day, &month, &year, &hours, &minutes, &seconds) != 6) {
+        return -1;
+    }
+    return hours * 3600 + minutes * 60 + seconds;
+}
+
+// Pairs every delivered line with the expected event it reports: same
+// notification and a stamp within a second or two of when the debouncer
+// accepted it. Lines stamped before the clock was set take the oldest
+// expected event of their kind that had happened by then.
+void matchDeliveries(std::vector<ExpectedEvent>& expected, std::vector<DeliveredLine>& lines, int64_t from_us,
+                     std::vector<const DeliveredLine*>& unexpected) {
+    for (const DeliveredLine& line : lines) {
+        if (line.key < 0) {
+            continue;
+        }
+        ExpectedEvent* best = nullptr;
+        int64_t bestDistance = INT64_MAX;
+        for (ExpectedEvent& event : expected) {
+            if (event.matched || event.key != line.key || event.stable_us > line.time_us) {
+                continue;
+            }
+            if (line.stampSecond < 0) {
+                best = &event;
+                break;
+            }
+            int64_t second = (from_us + event.stable_us) / 1000000;
+            int64_t distance = line.stampSecond - second;
+            if (distance >= -1 && distance <= 2 && llabs(distance) < bestDistance) {
+                best = &event;
+                bestDistance = llabs(distance);
+            }
+        }
+        if (best) {
+            best->matched = true;
+            best->delivered_us = line.time_us;
+        } else {
+            unexpected.push_back(&line);
+        }
+    }
+}
+
+// --- the run ---
+
+struct Capture {
+    std::vector<HalFlashOperation> flash;
+    uint32_t flashBytes = 0;
+    uint32_t flashWrites = 0;
+    uint32_t flashErases = 0;
+};
+
+Capture capture;
+std::vector<std::pair<int64_t, int64_t>> outages;     // on the boot clock, end INT64_MAX while open
+
+// No outage overlaps [from_us, to_us]
+bool onlineThroughout(int64_t from_us, int64_t to_us) {
+    for (const auto& outage : outages) {
+        if (outage.first <= to_us && outage.second > from_us) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void playTrace(const std::vector<TraceStep>* steps, int64_t from_us) {
+    HalClock& clock = halClock();
+    for (const TraceStep& step : *steps) {
+        if (step.time_us <= from_us) {
+            continue;
+        }
+        int64_t wait = step.time_us - from_us - clock.nowMicros();
+        if (wait > 0) {
+            clock.sleepMicros(wait);
+        }
+        if (step.pin == wifiPin) {
+            halSetWifiAvailable(step.level != 0);
+        } else {
+            halWritePin((uint8_t)step.pin, step.level);
+        }
+    }
+}
+
+void usage() {
+    fprintf(stderr, "usage: sensor_trace_sim [--trace FILE | --seed N] [--write-trace FILE] [--from HH:MM] [--to HH:MM]\n"
+                    "                        [--latency MS] [--dump] [--serial] [--strict]\n");
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (strcmp(arg, "--dump") == 0) {
+            options.dump = true;
+        } else if (strcmp(arg, "--serial") == 0) {
+            options.serial = true;
+        } else if (strcmp(arg, "--strict") == 0) {
+            options.strict = true;
+        } else if (!value) {
+            return false;
+        } else if (strcmp(arg, "--trace") == 0) {
+            options.tracePath = value;
+            i++;
+        } else if (strcmp(arg, "--write-trace") == 0) {
+            options.writeTracePath = value;
+            i++;
+        } else if (strcmp(arg, "--seed") == 0) {
+            options.seed = (uint32_t)strtoul(value, nullptr, 10);
+            i++;
+        } else if (strcmp(arg, "--latency") == 0) {
+            options.latency_us = (int64_t)atol(value) * 1000;
+            i++;
+        } else if (strcmp(arg, "--from") == 0 && parseDayTime(value, &options.from_us)) {
+            i++;
+        } else if (strcmp(arg, "--to") == 0 && parseDayTime(value, &options.to_us)) {
+            i++;
+        } else {
+            return false;
+        }
+    }
+    return options.to_us > options.from_us;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        usage();
+        return 2;
+    }
+
+    std::vector<TraceStep> steps;
+    if (options.tracePath) {
+        if (!readTrace(options.tracePath, steps)) {
+            return 2;
+        }
+    } else {
+        steps = syntheticDay(options.seed);
+    }
+    if (options.writeTracePath && !writeTrace(options.writeTracePath, steps, options.seed)) {
+        return 2;
+    }
+
+    // Everything from here on runs on simulated time
+    static VirtualClock clock;
+    static FakeTelegramApi telegram;
+    halSetClock(&clock);
+    halSetHttp(&telegram);
+    telegram.setEcho(false);
+    telegram.setLatency(options.latency_us);
+    halSetSerialOutput(options.serial ? stdout : nullptr);
+
+    struct tm day = {};
+    day.tm_year = dayYear - 1900;
+    day.tm_mon = dayMonth - 1;
+    day.tm_mday = dayOfMonth;
+    const int64_t midnight_us = ((int64_t)timegm(&day) - localOffsetSec) * 1000000;
+    halSetBootEpoch(midnight_us + options.from_us);
+
+    // As in partitions.csv
+    halAddPartition("evlog", ESP_PARTITION_TYPE_DATA, 0x40, 0x20000);
+    halSetFlashObserver([](const HalFlashOperation& operation) {
+        capture.flash.push_back(operation);
+        if (operation.erase) {
+            capture.flashErases++;
+        } else {
+            capture.flashWrites++;
+            capture.flashBytes += operation.size;
+        }
+    });
+
+    // Levels at boot: inactive, unless the trace says otherwise before it
+    SensorMask initial = 0;
+    bool wifiAtBoot = true;
+    for (size_t i = 0; i < sensorCount; i++) {
+        halWritePin(sensorTable[i].pin, inactiveLevel(i));
+    }
+    for (const TraceStep& step : steps) {
+        if (step.time_us > options.from_us) {
+            break;
+        }
+        if (step.pin == wifiPin) {
+            wifiAtBoot = step.level != 0;
+        } else {
+            halWritePin((uint8_t)step.pin, step.level);
+        }
+    }
+    for (size_t i = 0; i < sensorCount; i++) {
+        if (halReadPin(sensorTable[i].pin) != inactiveLevel(i)) {
+            initial |= sensorBit(i);
+        }
+    }
+    halSetWifiAvailable(wifiAtBoot);
+
+    // Run until the end of the day, and long enough after the last change to
+    // see it delivered
+    int64_t end_us = options.to_us - options.from_us;
+    if (!steps.empty()) {
+        end_us = std::max(end_us, steps.back().time_us - options.from_us + (int64_t)300 * 1000000);
+    }
+    for (const TraceStep& step : steps) {
+        if (step.pin != wifiPin || step.time_us <= options.from_us) {
+            continue;
+        }
+        int64_t at = step.time_us - options.from_us;
+        if (!step.level && (outages.empty() || outages.back().second != INT64_MAX)) {
+            outages.push_back(std::make_pair(at, INT64_MAX));
+        } else if (step.level && !outages.empty() && outages.back().second == INT64_MAX) {
+            outages.back().second = at;
+        }
+    }
+    if (!wifiAtBoot) {
+        outages.insert(outages.begin(), std::make_pair((int64_t)0, outages.empty() ? INT64_MAX : outages[0].first));
+    }
+
+    auto started = std::chrono::steady_clock::now();
+    setup();
+    const std::vector<TraceStep>* trace = &steps;
+    const int64_t from_us = options.from_us;
+    clock.spawn([trace, from_us]() { playTrace(trace, from_us); });
+    while (clock.nowMicros() < end_us) {
+        loop();
+    }
+    double realSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    // --- results, the firmware's tasks are parked while main has the turn ---
+
+    std::vector<ExpectedEvent> expected = expectedEvents(steps, initial, options.from_us, end_us);
+    std::vector<HalSentMessage> sent = telegram.sent();
+    std::vector<DeliveredLine> lines;
+    for (const HalSentMessage& message : sent) {
+        size_t start = 0;
+        while (start <= message.text.size()) {
+            size_t end = message.text.find('\n', start);
+            if (end == std::string::npos) {
+                end = message.text.size();
+            }
+            std::string text = message.text.substr(start, end - start);
+            lines.push_back(DeliveredLine{ message.time_us, templateKey(text), stampSecond(text), text });
+            start = end + 1;
+        }
+    }
+    std::vector<const DeliveredLine*> unexpected;
+    matchDeliveries(expected, lines, options.from_us, unexpected);
+
+    char when[16];
+    if (options.dump) {
+        printf("messages:\n");
+        for (const HalSentMessage& message : sent) {
+            printf("  %s  %s\n", formatDayTime(options.from_us + message.time_us, when, sizeof(when)),
+                   message.text.c_str());
+        }
+        printf("flash:\n");
+        for (const HalFlashOperation& operation : capture.flash) {
+            printf("  %s  %s %s 0x%05x +%u\n", formatDayTime(options.from_us + operation.time_us, when, sizeof(when)),
+                   operation.erase ? "erase" : "write", operation.label, (unsigned)operation.offset,
+                   (unsigned)operation.size);
+        }
+        printf("\n");
+    }
+
+    // Per hour of the local day
+    const int firstHour = (int)(options.from_us / 3600000000LL);
+    const int lastHour = (int)((options.from_us + end_us) / 3600000000LL);
+    std::vector<uint32_t> hourEvents(lastHour - firstHour + 1), hourMessages(hourEvents.size()),
+        hourLines(hourEvents.size()), hourFlash(hourEvents.size());
+    auto hourOf = [&](int64_t us) { return (size_t)((options.from_us + us) / 3600000000LL - firstHour); };
+    for (const ExpectedEvent& event : expected) {
+        hourEvents[hourOf(event.stable_us)]++;
+    }
+    for (const HalSentMessage& message : sent) {
+        hourMessages[hourOf(message.time_us)]++;
+    }
+    for (const DeliveredLine& line : lines) {
+        if (line.key >= 0) {
+            hourLines[hourOf(line.time_us)]++;
+        }
+    }
+    for (const HalFlashOperation& operation : capture.flash) {
+        hourFlash[hourOf(operation.time_us)]++;
+    }
+    printf("%-5s %8s %9s %10s %9s\n", "hour", "events", "messages", "delivered", "flash ops");
+    for (size_t i = 0; i < hourEvents.size(); i++) {
+        printf("%02d:00 %8u %9u %10u %9u\n", firstHour + (int)i, (unsigned)hourEvents[i], (unsigned)hourMessages[i],
+               (unsigned)hourLines[i], (unsigned)hourFlash[i]);
+    }
+
+    // Detection latency, pin edge to Telegram
+    uint32_t missed = 0;
+    int64_t totalLatency = 0, worstLatency = 0, worstOnline = 0;
+    const ExpectedEvent* worst = nullptr;
+    for (const ExpectedEvent& event : expected) {
+        if (!event.matched) {
+            missed++;
+            continue;
+        }
+        int64_t latency = event.delivered_us - event.edge_us;
+        totalLatency += latency;
+        if (latency > worstLatency) {
+            worstLatency = latency;
+            worst = &event;
+        }
+        if (onlineThroughout(event.edge_us, event.delivered_us)) {
+            worstOnline = std::max(worstOnline, latency);
+        }
+    }
+    uint32_t delivered = (uint32_t)expected.size() - missed;
+
+    char until[16];
+    printf("\n%s to %s, %u trace steps, simulated in %.2f s (%llu task switches)\n",
+           formatDayTime(options.from_us, when, sizeof(when)),
+           formatDayTime(options.from_us + end_us, until, sizeof(until)), (unsigned)steps.size(), realSeconds,
+           (unsigned long long)clock.switches());
+    printf("notifications: %u expected, %u delivered, %u missed, %u unexpected, %u messages (%.1f per open hour)\n",
+           (unsigned)expected.size(), (unsigned)delivered, (unsigned)missed, (unsigned)unexpected.size(),
+           (unsigned)sent.size(), sent.size() * 3600e6 / end_us);
+    if (delivered > 0) {
+        printf("detection latency: mean %.2f s, worst %.2f s", totalLatency / 1e6 / delivered, worstLatency / 1e6);
+        printf(" (%s at %s), worst without an outage %.2f s\n", keyName(worst->key).c_str(),
+               formatDayTime(options.from_us + worst->edge_us, when, sizeof(when)), worstOnline / 1e6);
+    }
+    EventLogStats log = eventLog.stats();
+    printf("flash: %u writes (%u bytes), %u erases; event log: %u appended, %u flushes, %u released, %u dropped\n",
+           (unsigned)capture.flashWrites, (unsigned)capture.flashBytes, (unsigned)capture.flashErases,
+           (unsigned)log.appended, (unsigned)log.flushes, (unsigned)log.released, (unsigned)log.dropped);
+
+    const size_t listed = 10;
+    size_t shown = 0;
+    for (const ExpectedEvent& event : expected) {
+        if (!event.matched && shown++ < listed) {
+            printf("missed: %s, edge at %s\n", keyName(event.key).c_str(),
+                   formatDayTime(options.from_us + event.edge_us, when, sizeof(when)));
+        }
+    }
+    for (size_t i = 0; i < unexpected.size() && i < listed; i++) {
+        printf("unexpected: %s, sent at %s\n", unexpected[i]->text.c_str(),
+               formatDayTime(options.from_us + unexpected[i]->time_us, when, sizeof(when)));
+    }
+
+    // The firmware's tasks never return, leave without running destructors under them
+    fflush(stdout);
+    _exit(options.strict && (missed > 0 || !unexpected.empty()) ? 1 : 0);
+}
@@ -0,0 +1,387 @@
+// Local stand-in for the Telegram Bot API, to load-test the firmware's
+// network paths and see how it copes with a misbehaving server before
+// production does.
+//
+// Serves sendMessage and getUpdates over plain HTTP/1.1 with keep-alive, the
+// way api.telegram.org answers them, through FakeTelegramApi of
+// lib/native_hal. Faults are drawn per request from a seeded generator:
+// connection resets, 429 with retry_after, 502s and bodies cut off halfway.
+// --group-limit throttles sendMessage like Telegram's per-group limit, and
+// --command-every posts a "status" reply for the command channel to pick up.
+//
+// Point the firmware at it with TELEGRAM_API_URL, see telegram_client.h:
+//
+//   pio run -e telegram_standin -t exec -a "--group-limit 20 --throttle 20"
+//   build_flags = ... -DTELEGRAM_API_URL=\"http://192.168.1.20:8081\"   (board)
+//   build_flags = ... -DTELEGRAM_API_URL=\"http://127.0.0.1:8081\"      (env:native)
+//
+// Every few seconds it prints the requests and messages per second and what
+// was injected; Ctrl-C prints the totals. --log writes every accepted
+// message as a JSON line with its arrival time in Unix microseconds.
+//
+// Options: --port N (8081), --bind ADDR (0.0.0.0), --latency MS,
+// --reset / --throttle / --server-error / --truncate PERMILLE (per thousand
+// requests), --retry-after S (5), --group-limit N (sends a minute, 0 = none),
+// --command-every S, --seed N, --log FILE, --report S (10), --quiet.
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include "native_hal.h"
+
+namespace {
+
+struct Options {
+    uint16_t port = 8081;
+    const char* bind = "0.0.0.0";
+    int64_t latency_us = 0;
+    HalApiFaults faults;
+    uint32_t seed = 1;
+    uint32_t commandEvery_s = 0;
+    const char* logPath = nullptr;
+    uint32_t report_s = 10;
+    bool quiet = false;
+};
+
+FakeTelegramApi api;
+std::atomic<uint32_t> openConnections(0);
+std::atomic<uint32_t> acceptedConnections(0);
+std::mutex logLock;
+FILE* messageLog = nullptr;
+volatile sig_atomic_t stopping = 0;
+
+int64_t unixMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+std::string jsonString(const std::string& text) {
+    std::string quoted = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+            quoted += c;
+        } else if ((uint8_t)c < 0x20) {
+            char escape[8];
+            snprintf(escape, sizeof(escape), "\\u%04x", (unsigned)(uint8_t)c);
+            quoted += escape;
+        } else {
+            quoted += c;
+        }
+    }
+    return quoted + "\"";
+}
+
+const char* reasonPhrase(int code) {
+    switch (code) {
+        case 200: return "OK";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 429: return "Too Many Requests";
+        case 502: return "Bad Gateway";
+        default: return "Error";
+    }
+}
+
+// Buffered reads off a client socket
+struct RequestReader {
+    int fd;
+    std::string buffer;
+
+    bool fill() {
+        char chunk[4096];
+        ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0) {
+            return false;
+        }
+        buffer.append(chunk, n);
+        return true;
+    }
+
+    bool line(std::string& out) {
+        size_t end;
+        while ((end = buffer.find("\r\n")) == std::string::npos) {
+            if (!fill()) {
+                return false;
+            }
+        }
+        out = buffer.substr(0, end);
+        buffer.erase(0, end + 2);
+        return true;
+    }
+
+    bool take(size_t size, std::string& out) {
+        while (buffer.size() < size) {
+            if (!fill()) {
+                return false;
+            }
+        }
+        out = buffer.substr(0, size);
+        buffer.erase(0, size);
+        return true;
+    }
+};
+
+bool sendAll(int fd, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return false;
+        }
+        sent += n;
+    }
+    return true;
+}
+
+// Answers requests on one connection until either side closes it
+void serveConnection(int fd) {
+    RequestReader reader = { fd, std::string() };
+    bool reused = false;
+    for (;;) {
+        std::string line;
+        char method[16];
+        char path[2048];
+        if (!reader.line(line) || sscanf(line.c_str(), "%15s %2047s HTTP/", method, path) != 2) {
+            break;
+        }
+
+        HalHttpRequest request;
+        request.method = method;
+        request.path = path;
+        request.port = 0;
+        request.https = false;
+        request.timeoutMs = 0;
+        request.connection = &reader;
+        request.reused = reused;
+        size_t contentLength = 0;
+        bool clientCloses = false;
+        while (reader.line(line) && !line.empty()) {
+            size_t colon = line.find(':');
+            if (colon == std::string::npos) {
+                continue;
+            }
+            std::string name = line.substr(0, colon);
+            size_t valueStart = line.find_first_not_of(' ', colon + 1);
+            std::string value = valueStart == std::string::npos ? std::string() : line.substr(valueStart);
+            request.headers[name] = value;
+            if (strcasecmp(name.c_str(), "Content-Length") == 0) {
+                contentLength = strtoul(value.c_str(), nullptr, 10);
+            } else if (strcasecmp(name.c_str(), "Connection") == 0) {
+                clientCloses = strcasecmp(value.c_str(), "close") == 0;
+            } else if (strcasecmp(name.c_str(), "Host") == 0) {
+                request.host = value;
+            }
+        }
+        if (contentLength > 0 && !reader.take(contentLength, request.body)) {
+            break;
+        }
+
+        HalHttpResponse response;
+        int code = api.request(request, response);
+        if (code <= 0) {
+            // Reset rather than a clean close, the way a dropped connection looks
+            struct linger reset = { 1, 0 };
+            setsockopt(fd, SOL_SOCKET, SO_LINGER, &reset, sizeof(reset));
+            break;
+        }
+
+        const bool keepAlive = response.keepAlive && !clientCloses;
+        char head[192];
+        snprintf(head, sizeof(head),
+                 "HTTP/1.1 %d %s\r\nContent-Type: application/json\r\nContent-Length: %u\r\nConnection: %s\r\n\r\n",
+                 code, reasonPhrase(code), (unsigned)(response.body.size() + response.missing),
+                 keepAlive ? "keep-alive" : "close");
+        if (!sendAll(fd, head + response.body) || !keepAlive) {
+            break;
+        }
+        reused = true;
+    }
+    close(fd);
+    openConnections--;
+}
+
+void logMessage(const HalSentMessage& message) {
+    if (!messageLog) {
+        return;
+    }
+    std::string line = "{\"received_us\":" + std::to_string(unixMicros()) + ",\"text\":" + jsonString(message.text) + "}\n";
+    std::lock_guard<std::mutex> lock(logLock);
+    fputs(line.c_str(), messageLog);
+    fflush(messageLog);
+}
+
+void printStats(const char* label, const HalApiStats& now, const HalApiStats& before, double seconds) {
+    printf("%s %u requests (%.1f/s), %u messages (%.1f/s), %u polls, %u updates, "
+           "%u throttled, %u 502s, %u truncated, %u resets, %u connections open\n",
+           label, (unsigned)(now.requests - before.requests), (now.requests - before.requests) / seconds,
+           (unsigned)(now.messages - before.messages), (now.messages - before.messages) / seconds,
+           (unsigned)(now.polls - before.polls), (unsigned)(now.updates - before.updates),
+           (unsigned)(now.throttled - before.throttled), (unsigned)(now.serverErrors - before.serverErrors),
+           (unsigned)(now.truncated - before.truncated), (unsigned)(now.resets - before.resets),
+           (unsigned)openConnections.load());
+}
+
+void reportTask(uint32_t interval_s) {
+    HalApiStats before = api.stats();
+    for (;;) {
+        std::this_thread::sleep_for(std::chrono::seconds(interval_s));
+        HalApiStats now = api.stats();
+        printStats("last interval:", now, before, interval_s);
+        before = now;
+    }
+}
+
+void commandTask(uint32_t interval_s) {
+    for (;;) {
+        std::this_thread::sleep_for(std::chrono::seconds(interval_s));
+        api.postUpdate("status", true);
+    }
+}
+
+void onSignal(int) {
+    stopping = 1;
+}
+
+bool parsePermille(const char* value, uint16_t* out) {
+    long permille = atol(value);
+    if (permille < 0 || permille > 1000) {
+        return false;
+    }
+    *out = (uint16_t)permille;
+    return true;
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (strcmp(arg, "--quiet") == 0) {
+            options.quiet = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            return false;
+        }
+        const char* value = argv[++i];
+        bool ok = true;
+        if (strcmp(arg, "--port") == 0) {
+            options.port = (uint16_t)atoi(value);
+        } else if (strcmp(arg, "--bind") == 0) {
+            options.bind = value;
+        } else if (strcmp(arg, "--latency") == 0) {
+            options.latency_us = (int64_t)atol(value) * 1000;
+        } else if (strcmp(arg, "--reset") == 0) {
+            ok = parsePermille(value, &options.faults.reset);
+        } else if (strcmp(arg, "--throttle") == 0) {
+            ok = parsePermille(value, &options.faults.throttle);
+        } else if (strcmp(arg, "--server-error") == 0) {
+            ok = parsePermille(value, &options.faults.serverError);
+        } else if (strcmp(arg, "--truncate") == 0) {
+            ok = parsePermille(value, &options.faults.truncate);
+        } else if (strcmp(arg, "--retry-after") == 0) {
+            options.faults.retryAfter_s = (uint32_t)atol(value);
+        } else if (strcmp(arg, "--group-limit") == 0) {
+            options.faults.groupPerMinute = (uint32_t)atol(value);
+        } else if (strcmp(arg, "--command-every") == 0) {
+            options.commandEvery_s = (uint32_t)atol(value);
+        } else if (strcmp(arg, "--seed") == 0) {
+            options.seed = (uint32_t)strtoul(value, nullptr, 10);
+        } else if (strcmp(arg, "--log") == 0) {
+            options.logPath = value;
+        } else if (strcmp(arg, "--report") == 0) {
+            options.report_s = (uint32_t)atol(value);
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            return false;
+        }
+    }
+    const HalApiFaults& faults = options.faults;
+    return faults.reset + faults.throttle + faults.serverError + faults.truncate <= 1000;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        fprintf(stderr, "usage: telegram_standin [--port N] [--bind ADDR] [--latency MS] [--reset|--throttle|"
+                        "--server-error|--truncate PERMILLE]\n"
+                        "                        [--retry-after S] [--group-limit N] [--command-every S] [--seed N]"
+                        " [--log FILE] [--report S] [--quiet]\n");
+        return 2;
+    }
+    if (options.logPath && !(messageLog = fopen(options.logPath, "a"))) {
+        fprintf(stderr, "cannot open %s\n", options.logPath);
+        return 2;
+    }
+
+    api.setEcho(!options.quiet);
+    api.setLatency(options.latency_us);
+    api.setFaults(options.faults, options.seed);
+    api.onMessage(logMessage);
+
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    int on = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(options.port);
+    if (inet_pton(AF_INET, options.bind, &address.sin_addr) != 1
+            || bind(listener, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 16) != 0) {
+        fprintf(stderr, "cannot listen on %s:%u: %s\n", options.bind, (unsigned)options.port, strerror(errno));
+        return 1;
+    }
+    printf("Telegram stand-in on http://%s:%u, latency %lld ms, faults per 1000: %u resets, %u 429s, %u 502s, "
+           "%u truncated, group limit %u/min\n",
+           options.bind, (unsigned)options.port, (long long)(options.latency_us / 1000),
+           (unsigned)options.faults.reset, (unsigned)options.faults.throttle, (unsigned)options.faults.serverError,
+           (unsigned)options.faults.truncate, (unsigned)options.faults.groupPerMinute);
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    if (options.report_s > 0) {
+        std::thread(reportTask, options.report_s).detach();
+    }
+    if (options.commandEvery_s > 0) {
+        std::thread(commandTask, options.commandEvery_s).detach();
+    }
+
+    auto started = std::chrono::steady_clock::now();
+    while (!stopping) {
+        struct pollfd waiting = { listener, POLLIN, 0 };
+        if (poll(&waiting, 1, 200) <= 0) {
+            continue;
+        }
+        int fd = accept(listener, nullptr, nullptr);
+        if (fd < 0) {
+            continue;
+        }
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        openConnections++;
+        acceptedConnections++;
+        std::thread(serveConnection, fd).detach();
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    printStats("\ntotal:", api.stats(), HalApiStats(), seconds);
+    printf("%u connections in %.1f s\n", (unsigned)acceptedConnections.load(), seconds);
+    // Connection threads may sit in a long poll, leave without waiting for them
+    fflush(stdout);
+    _exit(0);
+}
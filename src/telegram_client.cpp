@@ -0,0 +1,111 @@
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "telegram_client.h"
+
+// Used when a 429 carries no usable retry_after
+static const uint32_t defaultRetryAfter = 5;
+
+TelegramConnection::TelegramConnection(const char* botToken, const char* apiUrl) {
+    // scheme://host[:port][/path], https when the scheme is missing
+    String url = apiUrl;
+    int hostStart = url.indexOf("://");
+    if (hostStart >= 0) {
+        https_ = !url.substring(0, hostStart).equalsIgnoreCase("http");
+        hostStart += 3;
+    } else {
+        hostStart = 0;
+    }
+    int pathStart = url.indexOf('/', hostStart);
+    if (pathStart < 0) {
+        pathStart = url.length();
+    }
+    host_ = url.substring(hostStart, pathStart);
+    port_ = https_ ? 443 : 80;
+    int colon = host_.indexOf(':');
+    if (colon >= 0) {
+        port_ = (uint16_t)host_.substring(colon + 1).toInt();
+        host_ = host_.substring(0, colon);
+    }
+    String prefix = url.substring(pathStart);
+    if (prefix.endsWith("/")) {
+        prefix = prefix.substring(0, prefix.length() - 1);
+    }
+    botPath_ = prefix + "/bot" + botToken + "/";
+
+    // Same trust model as the previous http.begin(url) calls, no CA pinning
+    secureClient_.setInsecure();
+    client_ = https_ ? (WiFiClient*)&secureClient_ : &plainClient_;
+}
+
+int TelegramConnection::get(const char* method, const String& query) {
+    return send("GET", method, query, nullptr);
+}
+
+int TelegramConnection::postForm(const char* method, FormBodyStream& body) {
+    return send("POST", method, String(), &body);
+}
+
+int TelegramConnection::send(const char* type, const char* method, const String& query, FormBodyStream* body) {
+    String path = botPath_ + method;
+    if (query.length() > 0) {
+        path += "?" + query;
+    }
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        const bool reused = client_->connected();
+        if (!reused) {
+            handshakes_++;
+        }
+        requests_++;
+
+        http_.begin(*client_, host_, port_, path, https_);
+        http_.setReuse(true);
+        http_.setTimeout(timeoutMs_);
+
+        int code;
+        if (body) {
+            http_.addHeader("Content-Type", "application/x-www-form-urlencoded");
+            code = http_.sendRequest(type, body, body->size());
+        } else {
+            code = http_.sendRequest(type);
+        }
+
+        // A keep-alive socket the server already closed only shows up as a
+        // send or read error, so retry once on a fresh connection
+        if (code == 429) {
+            readRetryAfter();
+        }
+        if (code > 0 || !reused) {
+            return code;
+        }
+        Serial.printf("Telegram connection dropped (%d), reconnecting\n", code);
+        disconnect();
+        if (body) {
+            body->rewind();
+        }
+    }
+    return HTTPC_ERROR_CONNECTION_LOST;
+}
+
+// {"ok":false,"error_code":429,"description":"Too Many Requests: retry after 35",
+//  "parameters":{"retry_after":35}}
+void TelegramConnection::readRetryAfter() {
+    StaticJsonDocument<32> filter;
+    filter["parameters"]["retry_after"] = true;
+    StaticJsonDocument<64> doc;
+
+    retryAfter_ = defaultRetryAfter;
+    if (!deserializeJson(doc, http_.getStream(), DeserializationOption::Filter(filter))) {
+        retryAfter_ = doc["parameters"]["retry_after"] | defaultRetryAfter;
+    }
+}
+
+void TelegramConnection::finish() {
+    http_.end();
+}
+
+void TelegramConnection::disconnect() {
+    http_.setReuse(false);
+    http_.end();
+    client_->stop();
+}
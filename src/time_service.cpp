@@ -0,0 +1,200 @@
+#include <Arduino.h>
+#include <esp_sntp.h>
+#include <esp_system.h>
+#include <esp32/clk.h>
+#include "time_service.h"
+
+// Epoch microseconds at monotonic microseconds, set by the SNTP callback on
+// the lwIP task and read from any task
+static portMUX_TYPE anchorLock = portMUX_INITIALIZER_UNLOCKED;
+static int64_t anchorEpoch_us = 0;
+static int64_t anchorMonotonic_us = 0;
+static bool anchored = false;
+
+static long localOffsetSec = 0;
+static TimeServiceStats stats = {};
+static int64_t lastSync_us = 0;
+
+// RTC timer reading at esp_timer zero, converts between the two for this boot
+static int64_t rtcAtTimerZero_us = 0;
+
+// The anchor as of the last refresh, against the RTC timer. Lives in RTC
+// slow memory, which keeps its contents through a soft reboot.
+struct PersistedAnchor {
+    uint32_t magic;
+    uint32_t session;       // random per power-up, never 0, see StoredTime
+    uint32_t valid;         // an anchor has been stored this power-up
+    int64_t epoch_us;
+    int64_t rtc_us;         // RTC timer at epoch_us
+    uint32_t check;
+};
+static RTC_NOINIT_ATTR PersistedAnchor persisted;
+static const uint32_t persistedMagic = 0x54494d45;
+
+static uint32_t persistedCheck() {
+    // FNV-1a over everything in front of check
+    const uint8_t* bytes = (const uint8_t*)&persisted;
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < offsetof(PersistedAnchor, check); i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// Call with anchorLock held
+static void storeAnchor(int64_t now) {
+    persisted.epoch_us = anchorEpoch_us + (now - anchorMonotonic_us);
+    persisted.rtc_us = rtcAtTimerZero_us + now;
+    persisted.valid = 1;
+    persisted.check = persistedCheck();
+}
+
+static void restoreAnchor() {
+    rtcAtTimerZero_us = (int64_t)esp_clk_rtc_time() - monotonicMicros();
+
+    // A power-up leaves random contents, and some resets restart the RTC timer
+    bool intact = esp_reset_reason() != ESP_RST_POWERON
+               && persisted.magic == persistedMagic
+               && persisted.check == persistedCheck()
+               && persisted.rtc_us <= rtcAtTimerZero_us;
+    if (!intact) {
+        memset(&persisted, 0, sizeof(persisted));
+        persisted.magic = persistedMagic;
+        persisted.session = esp_random() | 1;
+        persisted.check = persistedCheck();
+        return;
+    }
+    if (!persisted.valid) {
+        return;
+    }
+
+    // Same anchor, expressed on this boot's esp_timer (it lies before zero)
+    anchorEpoch_us = persisted.epoch_us;
+    anchorMonotonic_us = persisted.rtc_us - rtcAtTimerZero_us;
+    anchored = true;
+    stats.restored = true;
+    Serial.printf("Clock restored from RTC memory, anchor %lu s old\n",
+                  (unsigned long)(-anchorMonotonic_us / 1000000));
+}
+
+static void onTimeSync(struct timeval* tv) {
+    int64_t now = monotonicMicros();
+    int64_t epoch_us = (int64_t)tv->tv_sec * 1000000 + tv->tv_usec;
+
+    portENTER_CRITICAL(&anchorLock);
+    if (anchored) {
+        int64_t predicted = anchorEpoch_us + (now - anchorMonotonic_us);
+        stats.lastCorrection_ms = (int32_t)((predicted - epoch_us) / 1000);
+    }
+    anchorEpoch_us = epoch_us;
+    anchorMonotonic_us = now;
+    anchored = true;
+    stats.syncs++;
+    stats.restored = false;
+    lastSync_us = now;
+    storeAnchor(now);
+    portEXIT_CRITICAL(&anchorLock);
+}
+
+void startTimeService(const char* server, long gmtOffsetSec, int daylightOffsetSec) {
+    localOffsetSec = gmtOffsetSec + daylightOffsetSec;
+    restoreAnchor();
+
+    sntp_set_time_sync_notification_cb(onTimeSync);
+    sntp_set_sync_interval(TIME_SYNC_INTERVAL_MS);
+    // Only configures and starts SNTP, the request goes out in the background
+    configTime(gmtOffsetSec, daylightOffsetSec, server);
+}
+
+void requestTimeSync() {
+    sntp_restart();
+}
+
+void persistTimeAnchor() {
+    static unsigned long lastPersist = 0;
+    if (millis() - lastPersist < TIME_PERSIST_INTERVAL_MS) {
+        return;
+    }
+    lastPersist = millis();
+
+    portENTER_CRITICAL(&anchorLock);
+    if (anchored) {
+        storeAnchor(monotonicMicros());
+    }
+    portEXIT_CRITICAL(&anchorLock);
+}
+
+bool timeSynced() {
+    portENTER_CRITICAL(&anchorLock);
+    bool synced = anchored;
+    portEXIT_CRITICAL(&anchorLock);
+    return synced;
+}
+
+bool epochAt(int64_t monotonic_us, time_t* epoch) {
+    portENTER_CRITICAL(&anchorLock);
+    bool synced = anchored;
+    int64_t epoch_us = anchorEpoch_us + (monotonic_us - anchorMonotonic_us);
+    portEXIT_CRITICAL(&anchorLock);
+
+    if (!synced) {
+        return false;
+    }
+    // Floor, also for instants just before the anchor
+    *epoch = (time_t)(epoch_us >= 0 ? epoch_us / 1000000 : (epoch_us - 999999) / 1000000);
+    return true;
+}
+
+static bool formatLocal(time_t epoch, char* buffer, size_t size) {
+    // Fixed offset, no DST rules to apply, so no need to go through TZ
+    time_t local = epoch + localOffsetSec;
+    struct tm timeinfo;
+    gmtime_r(&local, &timeinfo);
+    strftime(buffer, size, "%d/%m/%Y %H:%M:%S", &timeinfo);
+    return true;
+}
+
+bool formatTimestamp(int64_t monotonic_us, char* buffer, size_t size) {
+    time_t epoch;
+    return epochAt(monotonic_us, &epoch) && formatLocal(epoch, buffer, size);
+}
+
+StoredTime storedTimeAt(int64_t monotonic_us) {
+    StoredTime stored;
+    portENTER_CRITICAL(&anchorLock);
+    bool synced = anchored;
+    int64_t epoch_us = anchorEpoch_us + (monotonic_us - anchorMonotonic_us);
+    portEXIT_CRITICAL(&anchorLock);
+
+    if (synced) {
+        stored.ms = epoch_us / 1000;
+        stored.session = 0;
+    } else {
+        stored.ms = (rtcAtTimerZero_us + monotonic_us) / 1000;
+        stored.session = persisted.session;
+    }
+    return stored;
+}
+
+bool formatStoredTime(const StoredTime& time, char* buffer, size_t size) {
+    if (time.session == 0) {
+        return formatLocal((time_t)(time.ms / 1000), buffer, size);
+    }
+    // RTC time from before a power loss cannot be placed any more
+    if (time.session != persisted.session) {
+        return false;
+    }
+    return formatTimestamp(time.ms * 1000 - rtcAtTimerZero_us, buffer, size);
+}
+
+TimeServiceStats getTimeServiceStats() {
+    portENTER_CRITICAL(&anchorLock);
+    TimeServiceStats snapshot = stats;
+    int64_t lastSync = lastSync_us;
+    portEXIT_CRITICAL(&anchorLock);
+
+    if (snapshot.syncs > 0) {
+        snapshot.lastSyncAge_s = (uint32_t)((monotonicMicros() - lastSync) / 1000000);
+    }
+    return snapshot;
+}
@@ -0,0 +1,150 @@
+#include <Arduino.h>
+#include <WiFi.h>
+#include <atomic>
+#include "wifi_manager.h"
+
+enum WifiState : uint8_t {
+    WIFI_STATE_IDLE,        // startWifi() not called yet
+    WIFI_STATE_CONNECTING,  // WiFi.begin() issued, waiting for an IP address
+    WIFI_STATE_CONNECTED,
+    WIFI_STATE_BACKOFF,     // waiting for retryAt
+};
+
+static const char* wifiSsid = nullptr;
+static const char* wifiPassword = nullptr;
+
+// Written by the WiFi event task, read by serviceWifi()
+static std::atomic<bool> haveIp{false};
+static std::atomic<uint32_t> disconnectEvents{0};
+static std::atomic<uint8_t> disconnectReason{0};
+
+// State machine, only touched by serviceWifi() on the loop() task
+static WifiState state = WIFI_STATE_IDLE;
+static uint32_t attemptStartedAt = 0;
+static uint32_t disconnectsSeen = 0;    // disconnectEvents at the start of the attempt / connection
+static uint32_t retryAt = 0;
+static uint32_t offlineSince = 0;       // boot counts as offline
+static uint32_t backoff = WIFI_BACKOFF_MIN_MS;
+
+static WifiStats stats = {};
+
+static void onWifiEvent(arduino_event_id_t event, arduino_event_info_t info) {
+    switch (event) {
+        case ARDUINO_EVENT_WIFI_STA_GOT_IP:
+            haveIp = true;
+            break;
+        case ARDUINO_EVENT_WIFI_STA_LOST_IP:
+            haveIp = false;
+            break;
+        case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
+            disconnectReason = info.wifi_sta_disconnected.reason;
+            haveIp = false;
+            disconnectEvents++;
+            break;
+        default:
+            break;
+    }
+}
+
+static void beginAttempt(uint32_t now) {
+    stats.attempts++;
+    stats.outageAttempts++;
+    attemptStartedAt = now;
+    disconnectsSeen = disconnectEvents;
+    state = WIFI_STATE_CONNECTING;
+
+    Serial.printf("Connecting to WiFi, attempt %u\n", (unsigned)stats.outageAttempts);
+    WiFi.begin(wifiSsid, wifiPassword);
+}
+
+static void scheduleRetry(uint32_t now) {
+    // Equal jitter: half of the delay is fixed, the other half random, so
+    // devices that lost the same access point do not retry in lockstep
+    uint32_t delayMs = backoff / 2 + (uint32_t)random(backoff / 2 + 1);
+    retryAt = now + delayMs;
+    stats.backoffMs = delayMs;
+    backoff = min(backoff * 2, (uint32_t)WIFI_BACKOFF_MAX_MS);
+    state = WIFI_STATE_BACKOFF;
+}
+
+void startWifi(const char* ssid, const char* password) {
+    wifiSsid = ssid;
+    wifiPassword = password;
+
+    // Retries are ours, the driver must not reconnect on its own
+    WiFi.mode(WIFI_STA);
+    WiFi.setAutoReconnect(false);
+    WiFi.onEvent(onWifiEvent);
+
+    beginAttempt(millis());
+}
+
+WifiTransition serviceWifi() {
+    uint32_t now = millis();
+
+    switch (state) {
+        case WIFI_STATE_CONNECTED:
+            // A drop and a reconnect by the driver between two calls still counts
+            if (haveIp && disconnectEvents == disconnectsSeen) {
+                return WIFI_NO_CHANGE;
+            }
+            stats.disconnects++;
+            stats.outageAttempts = 0;
+            offlineSince = now;
+            backoff = WIFI_BACKOFF_MIN_MS;
+            WiFi.disconnect();
+            scheduleRetry(now);
+            Serial.printf("WiFi disconnected (reason %u)\n", (unsigned)disconnectReason);
+            return WIFI_LINK_DOWN;
+
+        case WIFI_STATE_CONNECTING: {
+            if (haveIp) {
+                uint32_t outage = now - offlineSince;
+                stats.connects++;
+                stats.lastReconnectMs = outage;
+                stats.maxReconnectMs = max(stats.maxReconnectMs, outage);
+                stats.offlineMs += outage;
+                stats.outageAttempts = 0;
+                stats.backoffMs = 0;
+                backoff = WIFI_BACKOFF_MIN_MS;
+                disconnectsSeen = disconnectEvents;
+                state = WIFI_STATE_CONNECTED;
+                Serial.printf("WiFi connected after %lu ms, IP address: %s\n",
+                              (unsigned long)outage, WiFi.localIP().toString().c_str());
+                return WIFI_LINK_UP;
+            }
+            bool failed = disconnectEvents != disconnectsSeen;
+            if (failed || now - attemptStartedAt >= WIFI_CONNECT_TIMEOUT_MS) {
+                stats.failedAttempts++;
+                stats.lastDisconnectReason = disconnectReason;
+                WiFi.disconnect();
+                scheduleRetry(now);
+                Serial.printf("WiFi attempt failed (%s), retrying in %lu ms\n",
+                              failed ? "disconnected" : "timeout", (unsigned long)stats.backoffMs);
+            }
+            return WIFI_NO_CHANGE;
+        }
+
+        case WIFI_STATE_BACKOFF:
+            if ((int32_t)(now - retryAt) >= 0) {
+                beginAttempt(now);
+            }
+            return WIFI_NO_CHANGE;
+
+        default:
+            return WIFI_NO_CHANGE;
+    }
+}
+
+bool wifiConnected() {
+    return state == WIFI_STATE_CONNECTED;
+}
+
+WifiStats getWifiStats() {
+    WifiStats snapshot = stats;
+    snapshot.lastDisconnectReason = disconnectReason;
+    if (state != WIFI_STATE_CONNECTED) {
+        snapshot.offlineMs += millis() - offlineSince;
+    }
+    return snapshot;
+}
@@ -0,0 +1,146 @@
+// event_codec: round trips, entry sizes, time base entries, and what the
+// decoder makes of erased, damaged and truncated flash.
+
+#include <unity.h>
+#include <string.h>
+#include "event_codec.h"
+
+namespace {
+
+EventRecord event(int64_t time_ms, uint32_t session, uint8_t type, uint8_t sensor, uint8_t active) {
+    EventRecord record = {};
+    record.time_ms = time_ms;
+    record.timeSession = session;
+    record.type = type;
+    record.sensor = sensor;
+    record.active = active;
+    return record;
+}
+
+const int64_t morning_ms = 1710230100000LL;     // 12/03/2024 08:15:00 UTC
+
+}  // namespace
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_round_trip() {
+    const EventRecord records[] = {
+        event(morning_ms, 0, 0, 0, 0),
+        event(morning_ms + 1500, 0, 0, 2, 1),
+        event(morning_ms + 61000, 0, 0, 31, 0),
+        event(morning_ms + 7200000, 0, 1, 0, 0),
+        event(morning_ms + 3000, 0, 0, 3, 1),       // clock stepped back
+        event(5000, 7, 0, 4, 1),                    // new power-up, clock unknown
+        event(9000, 7, 0, 4, 0),
+    };
+    const size_t count = sizeof(records) / sizeof(records[0]);
+
+    uint8_t buffer[count * eventEncodedMax];
+    EventTimeBase encodeBase = eventTimeBase(records[0]);
+    size_t length = 0;
+    for (size_t i = 0; i < count; i++) {
+        length += encodeEvent(records[i], encodeBase, buffer + length);
+    }
+
+    EventTimeBase decodeBase = eventTimeBase(records[0]);
+    size_t offset = 0;
+    for (size_t i = 0; i < count; i++) {
+        EventRecord decoded = {};
+        size_t consumed = 0;
+        TEST_ASSERT_EQUAL(EVENT_DECODED, decodeEvent(buffer + offset, length - offset, decodeBase, decoded, &consumed));
+        TEST_ASSERT_EQUAL_INT64(records[i].time_ms / 1000 * 1000, decoded.time_ms);
+        TEST_ASSERT_EQUAL_UINT32(records[i].timeSession, decoded.timeSession);
+        TEST_ASSERT_EQUAL(records[i].type, decoded.type);
+        TEST_ASSERT_EQUAL(records[i].sensor, decoded.sensor);
+        TEST_ASSERT_EQUAL(records[i].active, decoded.active);
+        offset += consumed;
+    }
+    TEST_ASSERT_EQUAL(length, offset);
+}
+
+void test_entry_sizes() {
+    uint8_t buffer[eventEncodedMax];
+    EventTimeBase base = { morning_ms / 1000, 0 };
+
+    TEST_ASSERT_EQUAL(3, encodeEvent(event(morning_ms + 60000, 0, 0, 1, 1), base, buffer));
+    TEST_ASSERT_EQUAL(4, encodeEvent(event(morning_ms + 60000 + 7200000, 0, 0, 1, 0), base, buffer));
+
+    // A change of time base adds a 14 byte entry in front
+    size_t length = encodeEvent(event(1000, 3, 0, 1, 1), base, buffer);
+    TEST_ASSERT_EQUAL(14 + 3, length);
+    TEST_ASSERT_TRUE(length <= eventEncodedMax);
+    TEST_ASSERT_EQUAL_UINT32(3, base.session);
+    TEST_ASSERT_EQUAL_INT64(1, base.time_s);
+}
+
+void test_negative_times_round_down() {
+    uint8_t buffer[eventEncodedMax];
+    EventRecord record = event(-1500, 0, 0, 0, 1);
+    EventTimeBase encodeBase = { 0, 0 };
+    size_t length = encodeEvent(record, encodeBase, buffer);
+
+    EventTimeBase decodeBase = { 0, 0 };
+    EventRecord decoded = {};
+    size_t consumed = 0;
+    TEST_ASSERT_EQUAL(EVENT_DECODED, decodeEvent(buffer, length, decodeBase, decoded, &consumed));
+    TEST_ASSERT_EQUAL_INT64(-2000, decoded.time_ms);
+}
+
+void test_erased_flash_is_the_end() {
+    uint8_t erased[eventEncodedMax];
+    memset(erased, 0xFF, sizeof(erased));
+    EventTimeBase base = { 0, 0 };
+    EventRecord decoded;
+    size_t consumed = 0;
+    TEST_ASSERT_EQUAL(EVENT_END, decodeEvent(erased, sizeof(erased), base, decoded, &consumed));
+    TEST_ASSERT_EQUAL(EVENT_END, decodeEvent(erased, 0, base, decoded, &consumed));
+}
+
+void test_flipped_bit_is_damage() {
+    uint8_t buffer[eventEncodedMax];
+    EventTimeBase base = { morning_ms / 1000, 0 };
+    size_t length = encodeEvent(event(morning_ms + 5000, 0, 0, 2, 1), base, buffer);
+
+    for (size_t byte = 0; byte < length; byte++) {
+        for (int bit = 0; bit < 8; bit++) {
+            uint8_t damaged[eventEncodedMax];
+            memcpy(damaged, buffer, length);
+            damaged[byte] ^= (uint8_t)(1 << bit);
+            EventTimeBase decodeBase = { morning_ms / 1000, 0 };
+            EventRecord decoded;
+            size_t consumed = 0;
+            EventDecodeResult result = decodeEvent(damaged, length, decodeBase, decoded, &consumed);
+            // A tag turned into 0xFF reads as erased, anything else as damaged
+            TEST_ASSERT_TRUE(result == EVENT_DAMAGED || (byte == 0 && damaged[0] == 0xFF && result == EVENT_END));
+        }
+    }
+}
+
+void test_truncated_entries_are_damage() {
+    uint8_t buffer[eventEncodedMax];
+    EventTimeBase base = { morning_ms / 1000, 0 };
+    size_t length = encodeEvent(event(5000, 9, 0, 2, 1), base, buffer);
+
+    // Cut right after the time base entry, what follows reads as not written yet
+    for (size_t cut = 1; cut < length; cut++) {
+        EventTimeBase decodeBase = { morning_ms / 1000, 0 };
+        EventRecord decoded;
+        size_t consumed = 0;
+        TEST_ASSERT_EQUAL(cut == 14 ? EVENT_END : EVENT_DAMAGED, decodeEvent(buffer, cut, decodeBase, decoded, &consumed));
+    }
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_round_trip);
+    RUN_TEST(test_entry_sizes);
+    RUN_TEST(test_negative_times_round_down);
+    RUN_TEST(test_erased_flash_is_the_end);
+    RUN_TEST(test_flipped_bit_is_damage);
+    RUN_TEST(test_truncated_entries_are_damage);
+    return UNITY_END();
+}
@@ -0,0 +1,233 @@
+// EventLog::recover(): what a new EventLog finds in the partition and NVS
+// the previous one left behind, the way begin() runs after a reboot.
+// The partition is the in-memory one from lib/native_hal, four sectors.
+
+#include <unity.h>
+#include <Arduino.h>
+#include <Preferences.h>
+#include <esp_partition.h>
+#include "event_log.h"
+#include "native_hal.h"
+
+namespace {
+
+const uint32_t sectorSize = 4096;
+const uint32_t sectors = 4;
+const int64_t morning_ms = 1710230100000LL;
+
+const esp_partition_t* partition() {
+    return esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, EVENT_LOG_PARTITION);
+}
+
+EventRecord event(uint32_t index) {
+    EventRecord record = {};
+    record.time_ms = morning_ms + (int64_t)index * 1000;
+    record.type = 0;
+    record.sensor = (uint8_t)(index % 5);
+    record.active = (uint8_t)(index & 1);
+    return record;
+}
+
+// Appends events first..first + count - 1 and writes them to flash
+void appendEvents(EventLog& log, uint32_t first, uint32_t count) {
+    for (uint32_t i = first; i < first + count; i++) {
+        TEST_ASSERT_TRUE(log.append(event(i)));
+    }
+    log.flush();
+}
+
+// Reads everything from position to the head, checking each event against
+// the one appended at that position
+uint32_t readAndCheck(EventLog& log, uint32_t position) {
+    uint32_t count = 0;
+    EventRecord records[16];
+    size_t n;
+    while ((n = log.read(position, records, 16)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            const EventRecord expected = event(records[i].sequence);
+            TEST_ASSERT_EQUAL_INT64(expected.time_ms, records[i].time_ms);
+            TEST_ASSERT_EQUAL(expected.sensor, records[i].sensor);
+            TEST_ASSERT_EQUAL(expected.active, records[i].active);
+            count++;
+        }
+    }
+    return count;
+}
+
+}  // namespace
+
+void setUp() {
+    if (!partition()) {
+        halAddPartition(EVENT_LOG_PARTITION, ESP_PARTITION_TYPE_DATA, 0x40, sectors * sectorSize);
+    }
+    esp_partition_erase_range(partition(), 0, sectors * sectorSize);
+    Preferences prefs;
+    prefs.begin("eventlog", false);
+    prefs.clear();
+    prefs.end();
+}
+
+void tearDown() {
+}
+
+void test_empty_partition() {
+    EventLog* log = new EventLog();
+    TEST_ASSERT_TRUE(log->begin());
+    TEST_ASSERT_EQUAL_UINT32(0, log->head());
+    TEST_ASSERT_EQUAL_UINT32(0, log->tail());
+    TEST_ASSERT_EQUAL_UINT32(0, readAndCheck(*log, 0));
+    delete log;
+}
+
+void test_missing_partition() {
+    EventLog* log = new EventLog();
+    TEST_ASSERT_FALSE(log->begin("nolog"));
+    TEST_ASSERT_FALSE(log->append(event(0)));
+    delete log;
+}
+
+void test_recovers_head_and_events() {
+    EventLog* log = new EventLog();
+    log->begin();
+    appendEvents(*log, 0, 10);
+    delete log;
+
+    log = new EventLog();
+    log->begin();
+    TEST_ASSERT_EQUAL_UINT32(10, log->head());
+    TEST_ASSERT_EQUAL_UINT32(0, log->tail());
+    TEST_ASSERT_EQUAL_UINT32(10, readAndCheck(*log, 0));
+
+    // Writing carries on where the previous boot stopped
+    appendEvents(*log, 10, 5);
+    TEST_ASSERT_EQUAL_UINT32(15, log->head());
+    TEST_ASSERT_EQUAL_UINT32(15, readAndCheck(*log, 0));
+    delete log;
+}
+
+void test_recovers_released_tail() {
+    EventLog* log = new EventLog();
+    log->begin();
+    appendEvents(*log, 0, 10);
+    log->release(4);
+    delete log;
+
+    log = new EventLog();
+    log->begin();
+    TEST_ASSERT_EQUAL_UINT32(4, log->tail());
+    TEST_ASSERT_EQUAL_UINT32(10, log->head());
+    TEST_ASSERT_EQUAL_UINT32(0, readAndCheck(*log, 0));
+    TEST_ASSERT_EQUAL_UINT32(6, readAndCheck(*log, 4));
+    delete log;
+}
+
+// More events than the partition holds: the oldest sectors were reused, the
+// tail is the first event still in flash
+void test_recovers_wrapped_log() {
+    const uint32_t total = 6000;
+    EventLog* log = new EventLog();
+    log->begin();
+    appendEvents(*log, 0, total);
+    const uint32_t tail = log->tail();
+    TEST_ASSERT_TRUE(tail > 0);
+    delete log;
+
+    log = new EventLog();
+    log->begin();
+    TEST_ASSERT_EQUAL_UINT32(total, log->head());
+    TEST_ASSERT_EQUAL_UINT32(tail, log->tail());
+    TEST_ASSERT_EQUAL_UINT32(total - tail, readAndCheck(*log, tail));
+    delete log;
+}
+
+// A write torn by a power loss leaves bytes that can't be written over:
+// the sector is closed and the next event starts a new one
+void test_torn_write_ends_the_sector() {
+    EventLog* log = new EventLog();
+    log->begin();
+    appendEvents(*log, 0, 5);
+    delete log;
+
+    uint8_t sector[sectorSize];
+    esp_partition_read(partition(), 0, sector, sectorSize);
+    uint32_t end = sectorSize;
+    while (end > 0 && sector[end - 1] == 0xFF) {
+        end--;
+    }
+    const uint8_t torn = 0x42;
+    esp_partition_write(partition(), end, &torn, 1);
+
+    log = new EventLog();
+    log->begin();
+    TEST_ASSERT_EQUAL_UINT32(5, log->head());
+    TEST_ASSERT_EQUAL_UINT32(1, log->stats().corruptSectors);
+    TEST_ASSERT_EQUAL_UINT32(0, log->stats().corruptEvents);
+    appendEvents(*log, 5, 3);
+    delete log;
+
+    esp_partition_read(partition(), sectorSize, sector, sectorSize);
+    TEST_ASSERT_TRUE(sector[0] != 0xFF);
+
+    log = new EventLog();
+    log->begin();
+    TEST_ASSERT_EQUAL_UINT32(8, log->head());
+    TEST_ASSERT_EQUAL_UINT32(8, readAndCheck(*log, 0));
+    delete log;
+}
+
+// Damage found when reading back costs the rest of the sector, counted
+// once however often the stretch is read again
+void test_damaged_entry_counts_the_events_lost() {
+    EventLog* log = new EventLog();
+    log->begin();
+    appendEvents(*log, 0, 10);
+
+    // Clears the time of the fifth event. Events are 3 bytes each here and
+    // follow the 32 byte sector header.
+    const uint8_t cleared = 0;
+    esp_partition_write(partition(), 32 + 4 * 3 + 1, &cleared, 1);
+
+    EventRecord records[16];
+    uint32_t position = 0;
+    TEST_ASSERT_EQUAL(4, log->read(position, records, 16));
+    TEST_ASSERT_EQUAL_UINT32(10, position);
+    TEST_ASSERT_EQUAL_UINT32(6, log->stats().corruptEvents);
+    TEST_ASSERT_EQUAL_UINT32(0, log->stats().corruptSectors);
+
+    position = 0;
+    log->read(position, records, 16);
+    TEST_ASSERT_EQUAL_UINT32(6, log->stats().corruptEvents);
+    delete log;
+}
+
+// A tail in NVS that doesn't fit the log found in flash is pulled back in
+void test_tail_out_of_range_is_clamped() {
+    EventLog* log = new EventLog();
+    log->begin();
+    appendEvents(*log, 0, 10);
+    delete log;
+
+    Preferences prefs;
+    prefs.begin("eventlog", false);
+    prefs.putUInt("tail", 1000);
+    prefs.end();
+
+    log = new EventLog();
+    log->begin();
+    TEST_ASSERT_EQUAL_UINT32(10, log->tail());
+    TEST_ASSERT_EQUAL_UINT32(0, log->stats().size);
+    delete log;
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_empty_partition);
+    RUN_TEST(test_missing_partition);
+    RUN_TEST(test_recovers_head_and_events);
+    RUN_TEST(test_recovers_released_tail);
+    RUN_TEST(test_recovers_wrapped_log);
+    RUN_TEST(test_torn_write_ends_the_sector);
+    RUN_TEST(test_damaged_entry_counts_the_events_lost);
+    RUN_TEST(test_tail_out_of_range_is_clamped);
+    return UNITY_END();
+}
@@ -0,0 +1,123 @@
+// url_encode.h against the old urlEncode() rules, and FormBodyStream read
+// byte by byte, in chunks and again after rewind().
+
+#include <unity.h>
+#include <string>
+#include "form_body.h"
+#include "url_encode.h"
+
+namespace {
+
+// The encoding urlEncodedWidth and urlEncodeByte() replaced
+std::string referenceEncode(const std::string& text) {
+    static const char hexDigits[] = "0123456789ABCDEF";
+    std::string out;
+    for (unsigned char c : text) {
+        if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) {
+            out += (char)c;
+        } else if (c == ' ') {
+            out += '+';
+        } else {
+            out += '%';
+            out += hexDigits[c >> 4];
+            out += hexDigits[c & 0xf];
+        }
+    }
+    return out;
+}
+
+std::string readAll(FormBodyStream& body) {
+    std::string out;
+    int c;
+    while ((c = body.read()) >= 0) {
+        out += (char)c;
+    }
+    return out;
+}
+
+}  // namespace
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_every_byte_matches_the_old_encoding() {
+    for (int c = 0; c < 256; c++) {
+        char out[3];
+        size_t length = urlEncodeByte((uint8_t)c, out);
+        std::string expected = referenceEncode(std::string(1, (char)c));
+        TEST_ASSERT_EQUAL(expected.size(), length);
+        TEST_ASSERT_EQUAL(expected.size(), urlEncodedWidth[c]);
+        TEST_ASSERT_TRUE(std::string(out, length) == expected);
+    }
+}
+
+void test_encoded_length() {
+    const char* text = "Drawer open at 12/03/2024 08:15:00";
+    TEST_ASSERT_EQUAL(referenceEncode(text).size(), urlEncodedLength(text, strlen(text)));
+    TEST_ASSERT_EQUAL(0, urlEncodedLength("", 0));
+}
+
+void test_body_is_prefix_and_encoded_value() {
+    FormBodyStream body("chat_id=-100123&text=", "Drawer open at 08:15, caf\xc3\xa9 & co");
+    const std::string expected = "chat_id=-100123&text=Drawer+open+at+08%3A15%2C+caf%C3%A9+%26+co";
+    TEST_ASSERT_EQUAL(expected.size(), body.size());
+    TEST_ASSERT_EQUAL(expected.size(), body.available());
+    TEST_ASSERT_EQUAL_STRING(expected.c_str(), readAll(body).c_str());
+    TEST_ASSERT_EQUAL(0, body.available());
+    TEST_ASSERT_EQUAL(-1, body.read());
+    TEST_ASSERT_EQUAL(-1, body.peek());
+}
+
+void test_peek_does_not_consume() {
+    FormBodyStream body("t=", "%");
+    TEST_ASSERT_EQUAL('t', body.peek());
+    TEST_ASSERT_EQUAL('t', body.read());
+    TEST_ASSERT_EQUAL('=', body.read());
+    TEST_ASSERT_EQUAL('%', body.peek());
+    TEST_ASSERT_EQUAL('%', body.read());
+    TEST_ASSERT_EQUAL('2', body.peek());
+    TEST_ASSERT_EQUAL(2, body.available());
+}
+
+void test_read_bytes_in_chunks_across_escapes() {
+    FormBodyStream body("text=", "a:b:c:d");
+    std::string out;
+    char chunk[4];
+    size_t n;
+    while ((n = body.readBytes(chunk, sizeof(chunk))) > 0) {
+        out.append(chunk, n);
+    }
+    TEST_ASSERT_EQUAL_STRING("text=a%3Ab%3Ac%3Ad", out.c_str());
+}
+
+void test_rewind_sends_the_same_body_again() {
+    FormBodyStream body("chat_id=1&text=", "Shop closed at 20:00");
+    char partial[10];
+    body.readBytes(partial, sizeof(partial));
+    const std::string first = std::string(partial, sizeof(partial)) + readAll(body);
+
+    body.rewind();
+    TEST_ASSERT_EQUAL(body.size(), body.available());
+    TEST_ASSERT_EQUAL_STRING(first.c_str(), readAll(body).c_str());
+}
+
+void test_empty_value() {
+    FormBodyStream body("chat_id=1&text=", "");
+    TEST_ASSERT_EQUAL(strlen("chat_id=1&text="), body.size());
+    TEST_ASSERT_EQUAL_STRING("chat_id=1&text=", readAll(body).c_str());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_every_byte_matches_the_old_encoding);
+    RUN_TEST(test_encoded_length);
+    RUN_TEST(test_body_is_prefix_and_encoded_value);
+    RUN_TEST(test_peek_does_not_consume);
+    RUN_TEST(test_read_bytes_in_chunks_across_escapes);
+    RUN_TEST(test_rewind_sends_the_same_body_again);
+    RUN_TEST(test_empty_value);
+    return UNITY_END();
+}
@@ -0,0 +1,166 @@
+// SensorDebouncer against the timings in sensorTable: a magnetic contact
+// with a short settle time in both directions, and a PIR input that reports
+// occupancy at once but has to stay quiet, and occupied long enough, before
+// it counts as vacant.
+
+#include <unity.h>
+#include "sensors.h"
+#include "sensor_debounce.h"
+
+namespace {
+
+size_t contact;         // first sensor with a settle time and no minimum active time
+size_t pir;             // first sensor with a minimum active time
+SensorMask closed;      // every contact closed, nobody at the desks
+
+uint32_t settleUs(size_t sensor, bool toActive) {
+    return (uint32_t)(toActive ? sensorTable[sensor].settleActiveMs : sensorTable[sensor].settleInactiveMs) * 1000;
+}
+
+uint32_t minActiveUs(size_t sensor) {
+    return (uint32_t)sensorTable[sensor].minActiveMs * 1000;
+}
+
+bool isActive(SensorMask state, size_t sensor) {
+    return state & sensorBit(sensor);
+}
+
+}  // namespace
+
+void setUp() {
+    contact = sensorCount;
+    pir = sensorCount;
+    closed = 0;
+    for (size_t i = 0; i < sensorCount; i++) {
+        const SensorDescriptor& sensor = sensorTable[i];
+        if (contact == sensorCount && sensor.minActiveMs == 0 && sensor.settleInactiveMs > 0) {
+            contact = i;
+        }
+        if (pir == sensorCount && sensor.minActiveMs > 0) {
+            pir = i;
+        }
+        if (!sensor.occupancy) {
+            closed |= sensorBit(i);
+        }
+    }
+}
+
+void tearDown() {
+}
+
+void test_table_has_a_contact_and_a_pir() {
+    TEST_ASSERT_TRUE(contact < sensorCount);
+    TEST_ASSERT_TRUE(pir < sensorCount);
+}
+
+void test_change_counts_once_settled() {
+    SensorDebouncer debouncer;
+    const SensorMask open = closed & ~sensorBit(contact);
+    debouncer.reset(closed, 0);
+
+    TEST_ASSERT_EQUAL_UINT32(closed, debouncer.update(open, 1000));
+    TEST_ASSERT_EQUAL_UINT32(closed, debouncer.update(open, 1000 + settleUs(contact, false) - 1));
+    TEST_ASSERT_EQUAL_UINT32(open, debouncer.update(open, 1000 + settleUs(contact, false)));
+}
+
+void test_bounce_shorter_than_settle_time_is_ignored() {
+    SensorDebouncer debouncer;
+    const SensorMask open = closed & ~sensorBit(contact);
+    debouncer.reset(closed, 0);
+
+    TEST_ASSERT_EQUAL_UINT32(closed, debouncer.update(open, 1000));
+    TEST_ASSERT_EQUAL_UINT32(closed, debouncer.update(closed, 1000 + settleUs(contact, false) / 2));
+    TEST_ASSERT_EQUAL_UINT32(closed, debouncer.update(closed, 1000000));
+    TEST_ASSERT_EQUAL_UINT32(closed, debouncer.stable());
+}
+
+// A change that has held for its settle time counts even when the input is
+// back before the next update, and the way back is reported as well
+void test_settled_change_survives_flip_back() {
+    SensorDebouncer debouncer;
+    const SensorMask open = closed & ~sensorBit(contact);
+    debouncer.reset(closed, 0);
+
+    TEST_ASSERT_EQUAL_UINT32(closed, debouncer.update(open, 1000));
+    TEST_ASSERT_EQUAL_UINT32(open, debouncer.update(closed, 61000));
+    TEST_ASSERT_EQUAL_UINT32(open, debouncer.update(closed, 61000 + settleUs(contact, true) - 1));
+    TEST_ASSERT_EQUAL_UINT32(closed, debouncer.update(closed, 61000 + settleUs(contact, true)));
+}
+
+void test_occupancy_is_reported_at_once() {
+    SensorDebouncer debouncer;
+    debouncer.reset(closed, 0);
+    TEST_ASSERT_TRUE(isActive(debouncer.update(closed | sensorBit(pir), 1000), pir));
+}
+
+void test_vacancy_waits_for_the_minimum_active_time() {
+    SensorDebouncer debouncer;
+    const SensorMask occupied = closed | sensorBit(pir);
+    debouncer.reset(closed, 0);
+    debouncer.update(occupied, 1000);
+
+    // Quiet for longer than the settle time, but not yet occupied long enough
+    const uint32_t quiet = 2000;
+    TEST_ASSERT_TRUE(isActive(debouncer.update(closed, quiet), pir));
+    TEST_ASSERT_TRUE(isActive(debouncer.update(closed, quiet + settleUs(pir, false)), pir));
+    TEST_ASSERT_TRUE(isActive(debouncer.update(closed, 1000 + minActiveUs(pir) - 1), pir));
+    TEST_ASSERT_FALSE(isActive(debouncer.update(closed, 1000 + minActiveUs(pir)), pir));
+}
+
+// Vacant and occupied again between two updates: both show, one per call
+void test_one_change_per_call() {
+    SensorDebouncer debouncer;
+    const SensorMask occupied = closed | sensorBit(pir);
+    debouncer.reset(occupied, 0);
+
+    const uint32_t quietFrom = minActiveUs(pir);
+    const uint32_t back = quietFrom + settleUs(pir, false) + 500000;
+    TEST_ASSERT_TRUE(isActive(debouncer.update(closed, quietFrom), pir));
+    TEST_ASSERT_FALSE(isActive(debouncer.update(occupied, back), pir));
+    TEST_ASSERT_TRUE(isActive(debouncer.update(occupied, back), pir));
+}
+
+// A glitch caught by one read of a polled input is not known to have lasted
+void test_sample_ignores_a_single_read() {
+    SensorDebouncer debouncer;
+    const SensorMask open = closed & ~sensorBit(contact);
+    debouncer.reset(closed, 0);
+
+    TEST_ASSERT_EQUAL_UINT32(closed, debouncer.sample(open, 100000));
+    TEST_ASSERT_EQUAL_UINT32(closed, debouncer.sample(closed, 200000));
+    TEST_ASSERT_EQUAL_UINT32(closed, debouncer.sample(closed, 300000));
+}
+
+void test_sample_accepts_two_reads_apart() {
+    SensorDebouncer debouncer;
+    const SensorMask open = closed & ~sensorBit(contact);
+    debouncer.reset(closed, 0);
+
+    TEST_ASSERT_EQUAL_UINT32(closed, debouncer.sample(open, 100000));
+    TEST_ASSERT_EQUAL_UINT32(open, debouncer.sample(open, 200000));
+}
+
+void test_settle_time_across_micros_wrap() {
+    SensorDebouncer debouncer;
+    const SensorMask open = closed & ~sensorBit(contact);
+    const uint32_t start = UINT32_MAX - 5000;
+    debouncer.reset(closed, start);
+
+    TEST_ASSERT_EQUAL_UINT32(closed, debouncer.update(open, start + 1000));
+    TEST_ASSERT_EQUAL_UINT32(open, debouncer.update(open, start + 1000 + settleUs(contact, false)));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_table_has_a_contact_and_a_pir);
+    RUN_TEST(test_change_counts_once_settled);
+    RUN_TEST(test_bounce_shorter_than_settle_time_is_ignored);
+    RUN_TEST(test_settled_change_survives_flip_back);
+    RUN_TEST(test_occupancy_is_reported_at_once);
+    RUN_TEST(test_vacancy_waits_for_the_minimum_active_time);
+    RUN_TEST(test_one_change_per_call);
+    RUN_TEST(test_sample_ignores_a_single_read);
+    RUN_TEST(test_sample_accepts_two_reads_apart);
+    RUN_TEST(test_settle_time_across_micros_wrap);
+    return UNITY_END();
+}
@@ -0,0 +1,112 @@
+// SpscRing: order, capacity, drops, index wrap, and one producer thread
+// against one consumer thread the way the GPIO ISR and loop() use it.
+
+#include <unity.h>
+#include <thread>
+#include "spsc_ring.h"
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_pops_in_push_order() {
+    SpscRing<uint32_t, 8> ring;
+    for (uint32_t i = 0; i < 5; i++) {
+        TEST_ASSERT_TRUE(ring.push(i));
+    }
+    TEST_ASSERT_EQUAL(5, ring.size());
+    for (uint32_t i = 0; i < 5; i++) {
+        uint32_t item = 0;
+        TEST_ASSERT_TRUE(ring.pop(item));
+        TEST_ASSERT_EQUAL_UINT32(i, item);
+    }
+    uint32_t item;
+    TEST_ASSERT_FALSE(ring.pop(item));
+    TEST_ASSERT_EQUAL(0, ring.size());
+}
+
+void test_full_ring_drops_and_counts() {
+    SpscRing<uint32_t, 4> ring;
+    for (uint32_t i = 0; i < 4; i++) {
+        TEST_ASSERT_TRUE(ring.push(i));
+    }
+    TEST_ASSERT_FALSE(ring.push(4));
+    TEST_ASSERT_FALSE(ring.push(5));
+    TEST_ASSERT_EQUAL_UINT32(2, ring.dropped());
+    TEST_ASSERT_EQUAL(ring.capacity(), ring.size());
+
+    // The items already queued are kept, the new ones are the ones lost
+    uint32_t item = 0;
+    TEST_ASSERT_TRUE(ring.pop(item));
+    TEST_ASSERT_EQUAL_UINT32(0, item);
+    TEST_ASSERT_TRUE(ring.push(6));
+    const uint32_t expected[] = { 1, 2, 3, 6 };
+    for (size_t i = 0; i < 4; i++) {
+        TEST_ASSERT_TRUE(ring.pop(item));
+        TEST_ASSERT_EQUAL_UINT32(expected[i], item);
+    }
+}
+
+void test_indices_wrap_around_many_times() {
+    SpscRing<uint32_t, 4> ring;
+    uint32_t next = 0;
+    for (uint32_t i = 0; i < 1000; i++) {
+        TEST_ASSERT_TRUE(ring.push(i));
+        TEST_ASSERT_TRUE(ring.push(i + 1000000));
+        uint32_t item = 0;
+        TEST_ASSERT_TRUE(ring.pop(item));
+        TEST_ASSERT_EQUAL_UINT32(next, item);
+        TEST_ASSERT_TRUE(ring.pop(item));
+        TEST_ASSERT_EQUAL_UINT32(next + 1000000, item);
+        next++;
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, ring.dropped());
+}
+
+// Every item pushed is either popped exactly once, in order, or counted as dropped
+void test_producer_and_consumer_threads() {
+    static SpscRing<uint32_t, 16> ring;
+    const uint32_t total = 200000;
+    uint32_t accepted = 0;
+
+    std::thread producer([&]() {
+        for (uint32_t i = 0; i < total; i++) {
+            if (ring.push(i)) {
+                accepted++;
+            }
+        }
+    });
+
+    uint32_t popped = 0;
+    uint32_t last = 0;
+    bool ordered = true;
+    bool done = false;
+    while (!done) {
+        // Read before popping: whatever the producer pushed by then is popped below
+        done = ring.dropped() + popped + ring.size() == total;
+        uint32_t item;
+        while (ring.pop(item)) {
+            if (popped > 0 && item <= last) {
+                ordered = false;
+            }
+            last = item;
+            popped++;
+        }
+    }
+    producer.join();
+
+    TEST_ASSERT_TRUE(ordered);
+    TEST_ASSERT_EQUAL_UINT32(accepted, popped);
+    TEST_ASSERT_EQUAL_UINT32(total, popped + ring.dropped());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_pops_in_push_order);
+    RUN_TEST(test_full_ring_drops_and_counts);
+    RUN_TEST(test_indices_wrap_around_many_times);
+    RUN_TEST(test_producer_and_consumer_threads);
+    return UNITY_END();
+}
@@ -0,0 +1,85 @@
+// TokenBucket: burst, steady refill, pause() for a 429 retry_after, and the
+// millisecond clock wrapping.
+
+#include <unity.h>
+#include "token_bucket.h"
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_burst_then_one_per_interval() {
+    TokenBucket bucket(3, 1000);
+    for (int i = 0; i < 3; i++) {
+        TEST_ASSERT_EQUAL_UINT32(0, bucket.wait(100));
+        bucket.take(100);
+    }
+    TEST_ASSERT_EQUAL(0, bucket.tokens());
+    TEST_ASSERT_EQUAL_UINT32(1000, bucket.wait(100));
+    TEST_ASSERT_EQUAL_UINT32(1, bucket.wait(1099));
+    TEST_ASSERT_EQUAL_UINT32(0, bucket.wait(1100));
+    bucket.take(1100);
+    TEST_ASSERT_EQUAL_UINT32(1000, bucket.wait(1100));
+}
+
+void test_refill_stops_at_burst() {
+    TokenBucket bucket(3, 1000);
+    bucket.take(0);
+    bucket.wait(60000);
+    TEST_ASSERT_EQUAL(3, bucket.tokens());
+
+    // A full bucket starts the interval over on the first take
+    bucket.take(60500);
+    TEST_ASSERT_EQUAL(2, bucket.tokens());
+    bucket.wait(61499);
+    TEST_ASSERT_EQUAL(2, bucket.tokens());
+    bucket.wait(61500);
+    TEST_ASSERT_EQUAL(3, bucket.tokens());
+}
+
+void test_take_on_empty_bucket_does_nothing() {
+    TokenBucket bucket(1, 1000);
+    bucket.take(0);
+    bucket.take(0);
+    TEST_ASSERT_EQUAL(0, bucket.tokens());
+    TEST_ASSERT_EQUAL_UINT32(1000, bucket.wait(0));
+}
+
+void test_pause_holds_refills_back() {
+    TokenBucket bucket(3, 1000);
+    bucket.pause(2000, 5000);
+    TEST_ASSERT_EQUAL(0, bucket.tokens());
+    TEST_ASSERT_EQUAL_UINT32(5000, bucket.wait(2000));
+    TEST_ASSERT_EQUAL_UINT32(1, bucket.wait(6999));
+    TEST_ASSERT_EQUAL_UINT32(0, bucket.wait(7000));
+    TEST_ASSERT_EQUAL(1, bucket.tokens());
+    bucket.wait(9000);
+    TEST_ASSERT_EQUAL(3, bucket.tokens());
+}
+
+void test_across_millis_wrap() {
+    TokenBucket bucket(2, 1000);
+    const uint32_t start = UINT32_MAX - 300;
+    bucket.take(start);
+    bucket.take(start);
+    TEST_ASSERT_EQUAL_UINT32(1000, bucket.wait(start));
+    TEST_ASSERT_EQUAL_UINT32(0, bucket.wait(start + 1000));
+    TEST_ASSERT_EQUAL(1, bucket.tokens());
+
+    bucket.take(start + 1000);
+    bucket.pause(start + 1000, 3000);
+    TEST_ASSERT_EQUAL_UINT32(3000, bucket.wait(start + 1000));
+    TEST_ASSERT_EQUAL_UINT32(0, bucket.wait(start + 4000));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_burst_then_one_per_interval);
+    RUN_TEST(test_refill_stops_at_burst);
+    RUN_TEST(test_take_on_empty_bucket_does_nothing);
+    RUN_TEST(test_pause_holds_refills_back);
+    RUN_TEST(test_across_millis_wrap);
+    return UNITY_END();
+}